@@ -0,0 +1,163 @@
+/* Header file for reading shaders and textures out of one packed, memory mapped archive */
+
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "mapped_file.h"
+
+/*
+ * Archive written by pack_assets, mapped once and never copied.
+ *
+ * The file starts with a header and an index of every asset, sorted by
+ * name, followed by the names and then the contents:
+ *
+ *      "PRNA", version, asset count, 0          (HEADER_SIZE bytes)
+ *      name offset, name length, data offset, data size   per asset
+ *      names, each followed by a 0 byte
+ *      contents, each at a multiple of ALIGNMENT and followed by a 0 byte
+ *
+ * All fields are 32 bit little endian offsets from the start of the file.
+ * Find hands out pointers into the mapping, so shader sources and pixels go
+ * to GL without being read into a buffer first, and the trailing 0 byte
+ * lets a shader source be used as a C string.
+ */
+class AssetArchive
+{
+public:
+    static const int HEADER_SIZE = 16;
+    static const int ENTRY_SIZE = 16;       /* Bytes of one index entry */
+    static const int ALIGNMENT = 16;        /* Contents start at multiples of this */
+    static const uint32_t VERSION = 1;
+
+    /* Contents of one asset inside the mapping, Data is NULL if missing */
+    struct Asset
+    {
+        const unsigned char *Data = NULL;
+        size_t Size = 0;
+    };
+
+    int Count = 0;                          /* Assets in the archive */
+    const char *Error = NULL;               /* Why the archive is unusable */
+
+    /*
+     * Effects:
+     *      Maps filename and validates its index. On failure Count is 0,
+     *      Error describes the problem and Find finds nothing.
+     */
+    explicit AssetArchive(const char *filename) : File(filename)
+    {
+        if (!File.Data)
+        {
+            Error = "cannot open or map file";
+            return;
+        }
+        Error = Parse();
+        if (Error)
+            Count = 0;
+    }
+
+    AssetArchive(const AssetArchive &) = delete;
+    AssetArchive &operator=(const AssetArchive &) = delete;
+
+    /*
+     * Effects:
+     *      Returns the asset stored under name, such as
+     *      "shaders/fogshader.vs", or an asset with NULL Data if there is
+     *      none. Safe to call from several threads at once.
+     */
+    Asset Find(const char *name) const
+    {
+        /* Binary search of the sorted index */
+        size_t length = strlen(name);
+        int low = 0;
+        int high = Count;
+        while (low < high)
+        {
+            int middle = low + (high - low) / 2;
+            int order = Compare(middle, name, length);
+            if (order == 0)
+            {
+                Asset asset;
+                asset.Data = File.Data + U32(Entry(middle) + 8);
+                asset.Size = U32(Entry(middle) + 12);
+                return asset;
+            }
+            if (order < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return Asset();
+    }
+
+    /* Returns the name of the asset at the given index position */
+    const char *Name(int index) const
+    {
+        return (const char *)File.Data + U32(Entry(index));
+    }
+
+private:
+    MappedFile File;
+
+    /* Little endian field of the archive */
+    uint32_t U32(size_t at) const
+    {
+        return File.Data[at] | (uint32_t)File.Data[at + 1] << 8 |
+               (uint32_t)File.Data[at + 2] << 16 | (uint32_t)File.Data[at + 3] << 24;
+    }
+
+    /* Offset of an index entry */
+    static size_t Entry(int index)
+    {
+        return HEADER_SIZE + (size_t)index * ENTRY_SIZE;
+    }
+
+    /* Orders the name of an entry against name, like strcmp */
+    int Compare(int index, const char *name, size_t length) const
+    {
+        size_t entryLength = U32(Entry(index) + 4);
+        int order = memcmp(Name(index), name, entryLength < length ? entryLength : length);
+        if (order != 0)
+            return order;
+        return entryLength < length ? -1 : entryLength > length;
+    }
+
+    /* Validates the header and index, returns NULL or an error */
+    const char *Parse()
+    {
+        if (File.Size < HEADER_SIZE || memcmp(File.Data, "PRNA", 4) != 0)
+            return "not an asset archive";
+        if (U32(4) != VERSION)
+            return "unsupported archive version";
+
+        uint32_t count = U32(8);
+        if (count > (File.Size - HEADER_SIZE) / ENTRY_SIZE)
+            return "index outside the file";
+
+        /* Every name and every content, with its 0 byte, must be inside the file */
+        for (uint32_t i = 0; i < count; i++)
+        {
+            size_t entry = Entry((int)i);
+            uint64_t nameEnd = (uint64_t)U32(entry) + U32(entry + 4);
+            uint64_t dataEnd = (uint64_t)U32(entry + 8) + U32(entry + 12);
+            if (nameEnd >= File.Size || File.Data[nameEnd] != 0)
+                return "name outside the file";
+            if (dataEnd >= File.Size || File.Data[dataEnd] != 0)
+                return "asset outside the file";
+        }
+
+        /* Names must be strictly increasing for Find */
+        Count = (int)count;
+        for (int i = 1; i < Count; i++)
+        {
+            if (Compare(i - 1, Name(i), U32(Entry(i) + 4)) >= 0)
+                return "index is not sorted";
+        }
+        return NULL;
+    }
+};
+
+#endif
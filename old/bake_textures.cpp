@@ -0,0 +1,369 @@
+/*
+ * Offline texture baker
+ *
+ * Turns a bmp texture into a DDS file that DdsFile can upload directly: the
+ * whole mip chain, box filtered like glGenerateMipmap, with every level
+ * compressed to BC1 (DXT1) blocks. Block rows are written bottom-up, in GL's
+ * order, like the rows of the bmp.
+ *
+ * Usage: bake_textures <input.bmp> <output.dds>
+ *
+ * Prints the PSNR of every level against its uncompressed mip.
+ */
+
+/* Library imports */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Header files */
+#include "bmp_file.h"
+#include "dds_file.h"
+
+/* One mip level as 8 bit RGB, rows bottom-up */
+struct Level
+{
+    int width;
+    int height;
+    std::vector<unsigned char> rgb;
+};
+
+/* Reads the bmp into a bottom-up RGB level, dropping any alpha */
+static Level read_level(const BmpFile &file)
+{
+    Level level;
+    level.width = file.Width;
+    level.height = file.Height;
+    level.rgb.resize((size_t)file.Width * file.Height * 3);
+    for (int row = 0; row < file.Height; row++)
+    {
+        int stored = file.TopDown ? file.Height - 1 - row : row;
+        const unsigned char *src = file.Pixels + (size_t)stored * file.Stride;
+        unsigned char *dst = &level.rgb[(size_t)row * file.Width * 3];
+        for (int x = 0; x < file.Width; x++)
+        {
+            dst[3 * x] = src[file.BytesPerPixel * x + 2];
+            dst[3 * x + 1] = src[file.BytesPerPixel * x + 1];
+            dst[3 * x + 2] = src[file.BytesPerPixel * x];
+        }
+    }
+    return level;
+}
+
+/* Averages 2x2 texels into the next level, clamping at odd edges */
+static Level next_level(const Level &level)
+{
+    Level next;
+    next.width = level.width > 1 ? level.width / 2 : 1;
+    next.height = level.height > 1 ? level.height / 2 : 1;
+    next.rgb.resize((size_t)next.width * next.height * 3);
+    for (int y = 0; y < next.height; y++)
+    {
+        int y0 = 2 * y < level.height ? 2 * y : level.height - 1;
+        int y1 = 2 * y + 1 < level.height ? 2 * y + 1 : level.height - 1;
+        for (int x = 0; x < next.width; x++)
+        {
+            int x0 = 2 * x < level.width ? 2 * x : level.width - 1;
+            int x1 = 2 * x + 1 < level.width ? 2 * x + 1 : level.width - 1;
+            for (int c = 0; c < 3; c++)
+            {
+                int sum = level.rgb[((size_t)y0 * level.width + x0) * 3 + c] +
+                          level.rgb[((size_t)y0 * level.width + x1) * 3 + c] +
+                          level.rgb[((size_t)y1 * level.width + x0) * 3 + c] +
+                          level.rgb[((size_t)y1 * level.width + x1) * 3 + c];
+                next.rgb[((size_t)y * next.width + x) * 3 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return next;
+}
+
+/* Rounds a color to RGB565 */
+static uint16_t pack_565(const float *color)
+{
+    int r = (int)std::lround(std::fmin(std::fmax(color[0], 0.0f), 255.0f) * 31 / 255);
+    int g = (int)std::lround(std::fmin(std::fmax(color[1], 0.0f), 255.0f) * 63 / 255);
+    int b = (int)std::lround(std::fmin(std::fmax(color[2], 0.0f), 255.0f) * 31 / 255);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+/* Expands RGB565 to 8 bit RGB the way decoders do */
+static void unpack_565(uint16_t packed, int *color)
+{
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+/*
+ * Picks the nearest of the four colors of endpoints c0 > c1 for every texel,
+ * writes the indices to indices and returns the squared error.
+ */
+static int fit_indices(const int texels[16][3], uint16_t c0, uint16_t c1, uint32_t *indices)
+{
+    int palette[4][3];
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    int error = 0;
+    *indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = texels[i][0] - palette[p][0];
+            int dg = texels[i][1] - palette[p][1];
+            int db = texels[i][2] - palette[p][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < bestError)
+            {
+                best = p;
+                bestError = e;
+            }
+        }
+        *indices |= (uint32_t)best << (2 * i);
+        error += bestError;
+    }
+    return error;
+}
+
+/*
+ * Orders the endpoints for four color mode, fits the indices and keeps the
+ * block if it beats the best so far.
+ */
+static void try_endpoints(const int texels[16][3], uint16_t c0, uint16_t c1,
+                          int *bestError, unsigned char *block)
+{
+    if (c0 < c1)
+    {
+        uint16_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    uint32_t indices = 0;
+    int error = 0;
+    if (c0 == c1)
+    {
+        /* Only three color mode is left, index 0 still gives the color */
+        int color[3];
+        unpack_565(c0, color);
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                error += (texels[i][c] - color[c]) * (texels[i][c] - color[c]);
+    }
+    else
+    {
+        error = fit_indices(texels, c0, c1, &indices);
+    }
+
+    if (error < *bestError)
+    {
+        *bestError = error;
+        block[0] = c0 & 255;
+        block[1] = c0 >> 8;
+        block[2] = c1 & 255;
+        block[3] = c1 >> 8;
+        for (int i = 0; i < 4; i++)
+            block[4 + i] = (indices >> (8 * i)) & 255;
+    }
+}
+
+/*
+ * Compresses 16 texels, row by row from the bottom, into one BC1 block.
+ * Endpoints start at the extremes along the principal axis of the colors and
+ * are then refined once by least squares on the chosen indices. Returns the
+ * squared error of the block.
+ */
+static int encode_block(const int texels[16][3], unsigned char *block)
+{
+    /* Mean and covariance of the colors */
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += texels[i][c] / 16.0f;
+    float cov[3][3] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < 3; a++)
+            for (int b = 0; b < 3; b++)
+                cov[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+
+    /* Principal axis by power iteration */
+    float axis[3] = {1, 1, 1};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3];
+        for (int a = 0; a < 3; a++)
+            next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int a = 0; a < 3; a++)
+            axis[a] = next[a] / length;
+    }
+
+    /* Extremes along the axis */
+    float low = 1e30f, high = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] +
+                  (texels[i][2] - mean[2]) * axis[2];
+        low = t < low ? t : low;
+        high = t > high ? t : high;
+    }
+    float start[3], end[3];
+    for (int c = 0; c < 3; c++)
+    {
+        start[c] = mean[c] + axis[c] * high;
+        end[c] = mean[c] + axis[c] * low;
+    }
+
+    int bestError = 1 << 30;
+    try_endpoints(texels, pack_565(start), pack_565(end), &bestError, block);
+
+    /* Least squares endpoints for the chosen indices */
+    uint16_t c0 = (uint16_t)(block[0] | block[1] << 8);
+    uint16_t c1 = (uint16_t)(block[2] | block[3] << 8);
+    if (c0 == c1)
+        return bestError;
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+    const float weights[4] = {1.0f, 0.0f, 2.0f / 3, 1.0f / 3};
+    float aa = 0, ab = 0, bb = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[(indices >> (2 * i)) & 3], b = 1 - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * texels[i][c];
+            bx[c] += b * texels[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return bestError;
+    for (int c = 0; c < 3; c++)
+    {
+        start[c] = (ax[c] * bb - bx[c] * ab) / det;
+        end[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    try_endpoints(texels, pack_565(start), pack_565(end), &bestError, block);
+    return bestError;
+}
+
+/*
+ * Compresses a level into blocks, clamping the texels of partial blocks at
+ * the edges, and returns the PSNR of the decoded level in dB.
+ */
+static double encode_level(const Level &level, std::vector<unsigned char> &blocks)
+{
+    int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+    double squared = 0;
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            int texels[16][3];
+            for (int i = 0; i < 16; i++)
+            {
+                int x = 4 * bx + i % 4, y = 4 * by + i / 4;
+                x = x < level.width ? x : level.width - 1;
+                y = y < level.height ? y : level.height - 1;
+                for (int c = 0; c < 3; c++)
+                    texels[i][c] = level.rgb[((size_t)y * level.width + x) * 3 + c];
+            }
+
+            unsigned char block[DdsFile::BLOCK_SIZE];
+            int error = encode_block(texels, block);
+            blocks.insert(blocks.end(), block, block + DdsFile::BLOCK_SIZE);
+
+            /* Clamped texels of partial blocks only count for their share */
+            int inside = (level.width - 4 * bx < 4 ? level.width - 4 * bx : 4) *
+                         (level.height - 4 * by < 4 ? level.height - 4 * by : 4);
+            squared += error * inside / 16.0;
+        }
+    }
+    double mse = squared / ((double)level.width * level.height * 3);
+    return mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99;
+}
+
+/* Writes a little endian 32 bit value at the given offset */
+static void put_u32(std::vector<unsigned char> &out, size_t at, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[at + i] = (value >> (8 * i)) & 255;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "Usage: %s <input.bmp> <output.dds>\n", argv[0]);
+        return 2;
+    }
+
+    BmpFile file(argv[1]);
+    if (!file.Pixels)
+    {
+        std::fprintf(stderr, "%s: %s\n", argv[1], file.Error);
+        return 1;
+    }
+
+    /* Compress the whole chain, down to 1x1 */
+    std::vector<unsigned char> blocks;
+    Level level = read_level(file);
+    int levels = 0;
+    for (;;)
+    {
+        double psnr = encode_level(level, blocks);
+        std::printf("Level %d: %dx%d, PSNR %.2f dB\n", levels, level.width, level.height, psnr);
+        levels++;
+        if (level.width == 1 && level.height == 1)
+            break;
+        level = next_level(level);
+    }
+
+    /* DDS header for DXT1 with a mip chain */
+    std::vector<unsigned char> header(DdsFile::HEADER_SIZE, 0);
+    std::memcpy(&header[0], "DDS ", 4);
+    put_u32(header, 4, 124);                                        // Header size
+    put_u32(header, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // Caps, size, format, mips, linear size
+    put_u32(header, 12, file.Height);
+    put_u32(header, 16, file.Width);
+    put_u32(header, 20, (uint32_t)DdsFile::Level_Size(file.Width, file.Height));
+    put_u32(header, 28, levels);
+    put_u32(header, 76, 32);                                        // Pixel format size
+    put_u32(header, 80, 0x4);                                       // Four character code
+    std::memcpy(&header[84], "DXT1", 4);
+    put_u32(header, 108, 0x1000 | 0x400000 | 0x8);                  // Texture, mipmap, complex
+
+    FILE *out = std::fopen(argv[2], "wb");
+    if (!out)
+    {
+        std::fprintf(stderr, "%s: cannot open for writing\n", argv[2]);
+        return 1;
+    }
+    bool written = std::fwrite(header.data(), 1, header.size(), out) == header.size() &&
+                   std::fwrite(blocks.data(), 1, blocks.size(), out) == blocks.size();
+    written = std::fclose(out) == 0 && written;
+    if (!written)
+    {
+        std::fprintf(stderr, "%s: write failed\n", argv[2]);
+        return 1;
+    }
+
+    std::printf("Wrote %s: %d levels, %zu bytes of blocks for %zu bytes of level 0 RGB\n",
+                argv[2], levels, blocks.size(), (size_t)file.Width * file.Height * 3);
+    return 0;
+}
@@ -0,0 +1,324 @@
+/* Header file for the compile-time specialized Perlin noise template */
+
+#ifndef BASIC_PERLIN_H
+#define BASIC_PERLIN_H
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+/* Ways Gradient can pick the gradient of a grid point */
+enum PerlinGradientMode
+{
+    PERLIN_GRADIENT_ANGLE = 0, /* cos/sin of Cos_Noise, reproduces existing worlds */
+    PERLIN_GRADIENT_TABLE = 1, /* unit gradient from a fixed table, no trig per corner */
+};
+
+/*
+ * Fixed set of unit gradients used by PERLIN_GRADIENT_TABLE. The angles sample
+ * the same range Cos_Noise produces, so both modes have the same look.
+ */
+template <typename Real>
+struct BasicGradientTable
+{
+    static const int SIZE = 256;
+    Real X[SIZE];
+    Real Y[SIZE];
+
+    BasicGradientTable()
+    {
+        for (int k = 0; k < SIZE; k++)
+        {
+            double angle = (2.0 - (k + 0.5) / (SIZE / 2)) * 3.14159265;
+            X[k] = (Real)std::cos(angle);
+            Y[k] = (Real)std::sin(angle);
+        }
+    }
+
+    /* Returns the table shared by every user of this precision */
+    static const BasicGradientTable &Get()
+    {
+        static const BasicGradientTable table;
+        return table;
+    }
+};
+
+typedef BasicGradientTable<double> PerlinGradientTable;
+
+/* Hashes that can pick the pseudorandom value of a grid point */
+enum PerlinHashMode
+{
+    PERLIN_HASH_PRIME = 0, /* prime polynomial of the original code, reproduces existing worlds */
+    PERLIN_HASH_MIX = 1,   /* multiply-xorshift mixer, better spread and cheap in SIMD lanes */
+};
+
+/*
+ * The prime based hash of Perlin::Hash. Unsigned arithmetic gives the same
+ * bits as the signed original without relying on overflow behaviour.
+ */
+struct PerlinPrimeHash
+{
+    static constexpr int MAX_OCTAVES = 5;
+    static constexpr uint32_t Primes[15] = {
+        7654567, 5195977, 1241087,
+        1866091, 3041789, 3069863,
+        1237547, 7794467, 7956589,
+        2495443, 4260917, 7004497,
+        1178711, 1600061, 9980869,
+    };
+
+    /* Returns the 30 bit hash of combined grid coordinate n for primes a, b and c */
+    static constexpr uint32_t Mix(uint32_t a, uint32_t b, uint32_t c, uint32_t n)
+    {
+        n = (n << 13) ^ n;
+        return (n * (n * n * a + b) + c) & 0x3fffffff;
+    }
+
+    /* Returns the 30 bit hash of grid point (x, y) for octave I */
+    template <int I>
+    static int32_t Hash(int32_t x, int32_t y)
+    {
+        uint32_t n = (uint32_t)x + (uint32_t)y * 59u;
+        return (int32_t)Mix(Primes[I * 3], Primes[I * 3 + 1], Primes[I * 3 + 2], n);
+    }
+};
+
+/*
+ * Hash of PERLIN_HASH_MIX. Coordinates are combined with odd multipliers and
+ * the octave key, then finalized with the lowbias32 multiply-xorshift mixer.
+ * Only 32 bit unsigned multiplies, xors and fixed shifts, so it is fully
+ * defined and maps one to one onto SIMD integer lanes.
+ */
+struct PerlinMixHash
+{
+    static constexpr int MAX_OCTAVES = PerlinPrimeHash::MAX_OCTAVES;
+
+    /* Returns the 30 bit hash of grid point (x, y, z) for the given key */
+    static constexpr uint32_t Mix(uint32_t key, uint32_t x, uint32_t y, uint32_t z)
+    {
+        uint32_t h = x * 0x9e3779b1u + y * 0x85ebca77u + z * 0xc2b2ae3du + key;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return h >> 2;
+    }
+
+    /* Returns the 30 bit hash of grid point (x, y) for octave I */
+    template <int I>
+    static int32_t Hash(int32_t x, int32_t y)
+    {
+        return (int32_t)Mix(PerlinPrimeHash::Primes[I * 3], (uint32_t)x, (uint32_t)y, 0);
+    }
+};
+
+/*
+ * Gradient noise with the precision, octave count and hash fixed at compile
+ * time. The octave loop is unrolled and every prime is an immediate.
+ *
+ * BasicPerlin<double, 5, PerlinPrimeHash> reproduces Perlin::Perlin_Val
+ * exactly for the default primes (seed 0 or rand()), and PerlinMixHash
+ * reproduces it with PERLIN_HASH_MIX; Perlin_Val runs on them for those
+ * primes. BasicPerlin<float> only beats double when the gradients come
+ * from cos and sin; with the table the hash dominates and both cost the same.
+ */
+template <typename Real, int Octaves = 5, typename HashPolicy = PerlinPrimeHash>
+class BasicPerlin
+{
+    static_assert(Octaves >= 1 && Octaves <= HashPolicy::MAX_OCTAVES,
+                  "Octave count not supported by the hash");
+
+public:
+    int GradientMode = PERLIN_GRADIENT_ANGLE;
+
+    /*
+     * Generates pseudorandom noise value between 0 and 2pi for octave I
+     */
+    template <int I>
+    Real Cos_Noise(int x, int y) const
+    {
+        int t = HashPolicy::template Hash<I>(x, y);
+        Real rand = Real(2.0) - (Real)(t) / Real(1 << 29);
+        return rand * Real(3.14159265);
+    }
+
+    /*
+     * Returns the unit gradient of a grid point for octave I in gx and gy
+     */
+    template <int I>
+    void Gradient_Vector(int ix, int iy, Real *gx, Real *gy) const
+    {
+        /* Look up the gradient, indexed by the top bits of the hash */
+        if (GradientMode == PERLIN_GRADIENT_TABLE)
+        {
+            int k = HashPolicy::template Hash<I>(ix, iy) >> 22;
+            *gx = Table->X[k];
+            *gy = Table->Y[k];
+            return;
+        }
+
+        Real noise = Cos_Noise<I>(ix, iy);
+        *gx = std::cos(noise);
+        *gy = std::sin(noise);
+    }
+
+    /*
+     * Calculates the dot product with the gradient for octave I
+     */
+    template <int I>
+    Real Gradient(int ix, int iy, Real x, Real y) const
+    {
+        /* Calculate distances */
+        Real dx = x - (Real)ix;
+        Real dy = y - (Real)iy;
+
+        /* Return dot product */
+        Real gx, gy;
+        Gradient_Vector<I>(ix, iy, &gx, &gy);
+        return (dx * gx + dy * gy) * Real(0.5) + Real(0.5);
+    }
+
+    /* Same as (int)floor(x) for every x in int range, without the libm call */
+    static int Fast_Floor(Real x)
+    {
+        int i = (int)x;
+        return i - (x < (Real)i);
+    }
+
+    /* Interpolates between two values */
+    static Real Interpolate(Real a, Real b, Real w)
+    {
+        w = w > 1 ? 1 : w;
+        w = w < 0 ? 0 : w;
+        return (b - a) * w + a;
+    }
+
+    /*
+     * Calculates perlin of octave I at a given location
+     */
+    template <int I>
+    Real Calc_Perlin(Real x, Real y) const
+    {
+        /* Grid points */
+        int x0 = Fast_Floor(x);
+        int x1 = x0 + 1;
+        int y0 = Fast_Floor(y);
+        int y1 = y0 + 1;
+
+        /* Interpolation values */
+        Real fx = x - (Real)x0;
+        Real fy = y - (Real)y0;
+
+        Real i1 = Interpolate(Gradient<I>(x0, y0, x, y), Gradient<I>(x1, y0, x, y), fx);
+        Real i2 = Interpolate(Gradient<I>(x0, y1, x, y), Gradient<I>(x1, y1, x, y), fx);
+
+        return Interpolate(i1, i2, fy);
+    }
+
+    /*
+     * Calculates perlin of octave I at a given location, and its partial
+     * derivatives in ddx and ddy, as Perlin::Calc_PerlinDeriv
+     */
+    template <int I>
+    Real Calc_PerlinDeriv(Real x, Real y, Real *ddx, Real *ddy) const
+    {
+        /* Grid points */
+        int x0 = Fast_Floor(x);
+        int x1 = x0 + 1;
+        int y0 = Fast_Floor(y);
+        int y1 = y0 + 1;
+
+        /* Interpolation values */
+        Real fx = x - (Real)x0;
+        Real fy = y - (Real)y0;
+
+        /* Corner gradients, each corner is linear in x and y */
+        Real gx[4], gy[4];
+        Gradient_Vector<I>(x0, y0, &gx[0], &gy[0]);
+        Gradient_Vector<I>(x1, y0, &gx[1], &gy[1]);
+        Gradient_Vector<I>(x0, y1, &gx[2], &gy[2]);
+        Gradient_Vector<I>(x1, y1, &gx[3], &gy[3]);
+
+        const Real half = Real(0.5);
+        Real g00 = (fx * gx[0] + fy * gy[0]) * half + half;
+        Real g10 = ((x - (Real)x1) * gx[1] + fy * gy[1]) * half + half;
+        Real g01 = (fx * gx[2] + (y - (Real)y1) * gy[2]) * half + half;
+        Real g11 = ((x - (Real)x1) * gx[3] + (y - (Real)y1) * gy[3]) * half + half;
+
+        /* Interpolate along x */
+        Real i1 = Interpolate(g00, g10, fx);
+        Real i2 = Interpolate(g01, g11, fx);
+        Real i1x = (gx[0] + (gx[1] - gx[0]) * fx) * half + (g10 - g00);
+        Real i2x = (gx[2] + (gx[3] - gx[2]) * fx) * half + (g11 - g01);
+        Real i1y = (gy[0] + (gy[1] - gy[0]) * fx) * half;
+        Real i2y = (gy[2] + (gy[3] - gy[2]) * fx) * half;
+
+        /* Interpolate along y */
+        *ddx = i1x + (i2x - i1x) * fy;
+        *ddy = i1y + (i2y - i1y) * fy + (i2 - i1);
+        return Interpolate(i1, i2, fy);
+    }
+
+    /*
+     * Sums every octave at a given location, as Perlin::Perlin_Val
+     */
+    Real Perlin_Val(Real x, Real y) const
+    {
+        return Sum_Octaves(x, y, std::make_integer_sequence<int, Octaves>());
+    }
+
+    /*
+     * Sums every octave at a given location and writes the analytic partial
+     * derivatives to dx and dy, as Perlin::Perlin_ValDeriv
+     */
+    Real Perlin_ValDeriv(Real x, Real y, Real *dx, Real *dy) const
+    {
+        *dx = 0;
+        *dy = 0;
+        return Sum_OctavesDeriv(x, y, dx, dy, std::make_integer_sequence<int, Octaves>());
+    }
+
+private:
+    /* Shared table of PERLIN_GRADIENT_TABLE, fetched once instead of per corner */
+    const BasicGradientTable<Real> *Table = &BasicGradientTable<Real>::Get();
+
+    /* Contribution of octave I */
+    template <int I>
+    Real Octave(Real x, Real y) const
+    {
+        return Calc_Perlin<I>(x / Real(1 << (4 + I)), y / Real(1 << (4 + I))) / Real(1 << I);
+    }
+
+    /* Contribution of octave I, adding its derivatives to dx and dy */
+    template <int I>
+    Real OctaveDeriv(Real x, Real y, Real *dx, Real *dy) const
+    {
+        const Real scale = Real(1 << (4 + I));
+        Real octaveX, octaveY;
+        Real value = Calc_PerlinDeriv<I>(x / scale, y / scale, &octaveX, &octaveY) / Real(1 << I);
+        *dx += octaveX / (scale * Real(1 << I));
+        *dy += octaveY / (scale * Real(1 << I));
+        return value;
+    }
+
+    /* Adds the octaves in order, expanded at compile time */
+    template <int... Is>
+    Real Sum_Octaves(Real x, Real y, std::integer_sequence<int, Is...>) const
+    {
+        Real total = 0;
+        ((total += Octave<Is>(x, y)), ...);
+        return total;
+    }
+
+    /* Adds the octaves and their derivatives in order */
+    template <int... Is>
+    Real Sum_OctavesDeriv(Real x, Real y, Real *dx, Real *dy, std::integer_sequence<int, Is...>) const
+    {
+        Real total = 0;
+        ((total += OctaveDeriv<Is>(x, y, dx, dy)), ...);
+        return total;
+    }
+};
+
+#endif
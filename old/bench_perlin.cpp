@@ -0,0 +1,455 @@
+/*
+ * Benchmark for the Perlin noise implementations
+ *
+ * Every noise function is timed over a square of samples covering the noise
+ * grid, for several grid sizes, for the scalar and batch paths and on one and
+ * several threads. Results are printed as a table, or as JSON with --json so
+ * runs can be saved and diffed.
+ *
+ * Usage: bench_perlin [--json] [--threads N]
+ *
+ * ns_per_sample and samples_per_second are wall clock throughput over all
+ * threads. cycles_per_sample is time stamp counter cycles spent per sample on
+ * each thread, 0 where there is no counter.
+ *
+ * Before timing, Perlin_Val (BasicPerlin<double> for the default primes) is
+ * checked against the sum of Calc_Perlin octaves, and every
+ * batch kernel against the scalar lanes, bit for bit; a mismatch exits 1.
+ */
+
+/* Library imports */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+/* Header files */
+#include "noise_expr.h"
+#include "thread_pool.h"
+#include "worley.h"
+
+/* Benchmark settings */
+const int SAMPLE_SIDE = 256;                 // Samples are taken on a SAMPLE_SIDE x SAMPLE_SIDE grid
+const int REPEATS = 3;                       // Fastest of this many runs is reported
+const int GRID_SIZES[3] = {64, 256, 1024};   // Noise grid sides to benchmark
+const int DEFAULT_GRID = 256;                // Grid for functions that do not read the grid
+const int ROW_TILE = 8;                      // Rows per task when multithreaded
+const int MAX_THREADS = 1024;                // Largest --threads accepted
+
+/* Keeps results alive so the compiler cannot drop the work */
+volatile double sink;
+
+/* Timing of one function on one configuration */
+struct Result
+{
+    std::string function;
+    std::string path;       /* scalar, batch-<simd level>, pyramid or template */
+    std::string gradient;   /* Gradient mode, or none if it does not apply */
+    int grid;
+    int threads;
+    double nsPerSample;
+    double cyclesPerSample;
+};
+
+/*
+ * Evaluates rows [start, end) of a benchmark into out, which holds one row.
+ * Every row has the same number of samples.
+ */
+typedef std::function<void(int start, int end, double *out)> RowWork;
+
+/* Returns the time stamp counter, or 0 without one */
+static unsigned long long read_cycles()
+{
+#ifdef BENCH_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Requires:
+ *      work evaluates rows of side samples each.
+ *
+ * Effects:
+ *      Times rows x side samples of work split across threads of pool (or
+ *      on the calling thread if pool is NULL) and returns the fastest run.
+ */
+static Result time_rows(ThreadPool *pool, int rows, int side, const RowWork &work)
+{
+    Result result;
+    result.threads = pool ? (int)pool->Size() : 1;
+    result.nsPerSample = 1e300;
+    result.cyclesPerSample = 1e300;
+
+    for (int r = 0; r < REPEATS; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long cycles = read_cycles();
+        if (pool)
+        {
+            /* Every task keeps its last sample in its own slot, only read once all are done */
+            std::vector<double> tails((rows + ROW_TILE - 1) / ROW_TILE);
+            pool->Parallel_For(0, rows, ROW_TILE, [&](int first, int last) {
+                std::vector<double> out(side);
+                work(first, last, out.data());
+                tails[first / ROW_TILE] = out[side - 1];
+            });
+            double total = 0;
+            for (double tail : tails)
+                total += tail;
+            sink = total;
+        }
+        else
+        {
+            std::vector<double> out(side);
+            work(0, rows, out.data());
+            sink = out[side - 1];
+        }
+        cycles = read_cycles() - cycles;
+        auto end = std::chrono::steady_clock::now();
+
+        double samples = (double)rows * side;
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / samples;
+        double perSample = (double)cycles * result.threads / samples;
+        result.nsPerSample = ns < result.nsPerSample ? ns : result.nsPerSample;
+        result.cyclesPerSample = perSample < result.cyclesPerSample ? perSample : result.cyclesPerSample;
+    }
+    return result;
+}
+
+/*
+ * Effects:
+ *      Returns row work evaluating noise(x, y) one sample at a time over a
+ *      grid x grid area.
+ */
+template <typename Noise>
+static RowWork scalar_rows(int grid, Noise noise)
+{
+    return [grid, noise](int start, int end, double *out) {
+        double step = (double)grid / SAMPLE_SIDE;
+        for (int y = start; y < end; y++)
+            for (int x = 0; x < SAMPLE_SIDE; x++)
+                out[x] = noise(x * step, y * step);
+    };
+}
+
+/*
+ * Effects:
+ *      Returns row work evaluating a batch function over a grid x grid area
+ *      a row at a time.
+ */
+template <typename Batch>
+static RowWork batch_rows(int grid, Batch batch)
+{
+    return [grid, batch](int start, int end, double *out) {
+        double step = (double)grid / SAMPLE_SIDE;
+        double xs[SAMPLE_SIDE], ys[SAMPLE_SIDE];
+        for (int x = 0; x < SAMPLE_SIDE; x++)
+            xs[x] = x * step;
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < SAMPLE_SIDE; x++)
+                ys[x] = y * step;
+            batch(xs, ys, out, SAMPLE_SIDE);
+        }
+    };
+}
+
+/* Runs every benchmark on the given thread count and appends the results */
+static void run_all(ThreadPool *pool, std::vector<Result> &results)
+{
+    const char *modes[2] = {"angle", "table"};
+    const char *levels[3] = {"scalar", "sse41", "avx2"};
+    const int detected = Perlin_Simd_Detect();
+
+    auto add = [&](const char *function, std::string path, const char *gradient, int grid,
+                   int rows, int side, const RowWork &work) {
+        Result result = time_rows(pool, rows, side, work);
+        result.function = function;
+        result.path = path;
+        result.gradient = gradient;
+        result.grid = grid;
+        results.push_back(result);
+    };
+
+    /* Functions reading the noise grid */
+    for (int grid : GRID_SIZES)
+    {
+        Perlin perlin(grid, grid, 1);
+        const Perlin *p = &perlin;
+
+        add("SmoothNoise", "scalar", "none", grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) { return p->SmoothNoise(x, y); }));
+        add("Turbulence", "scalar", "none", grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) { return p->Turbulence(x, y, p->size); }));
+        add("Perlin_Marble", "scalar", "none", grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) { return p->Perlin_Marble(x, y); }));
+
+        for (int level = PERLIN_SIMD_SCALAR; level <= detected; level++)
+        {
+            Perlin_Simd_Level() = level;
+            add("Perlin_Marble", std::string("batch-") + levels[level], "none", grid,
+                SAMPLE_SIDE, SAMPLE_SIDE,
+                batch_rows(grid, [p](const double *xs, const double *ys, double *out, int count) {
+                    p->Perlin_Marble_Batch(xs, ys, out, count);
+                }));
+        }
+        Perlin_Simd_Level() = detected;
+
+        auto marble = perlin_marble(perlin);
+        add("Perlin_Marble", "expression", "none", grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [marble](double x, double y) { return marble.Value(x, y); }));
+
+        /* The pyramid works on whole pixels, one per grid cell, a tile at a time */
+        add("Perlin_Marble", "pyramid", "none", grid, grid, grid, [p, grid](int start, int end, double *out) {
+            std::vector<double> tile((size_t)(end - start) * grid);
+            p->Perlin_Marble_Region(0, start, grid, end - start, tile.data());
+            out[grid - 1] = tile.back();
+        });
+    }
+
+    /* Gradient noise does not read the grid, so one size is enough */
+    Perlin perlin(DEFAULT_GRID, DEFAULT_GRID, 1);
+    BasicPerlin<double> perlinDouble;
+    BasicPerlin<float> perlinFloat;
+    for (int mode = PERLIN_GRADIENT_ANGLE; mode <= PERLIN_GRADIENT_TABLE; mode++)
+    {
+        perlin.GradientMode = mode;
+        perlinDouble.GradientMode = mode;
+        perlinFloat.GradientMode = mode;
+        const Perlin *p = &perlin;
+        const BasicPerlin<double> *pd = &perlinDouble;
+        const BasicPerlin<float> *pf = &perlinFloat;
+        const int grid = DEFAULT_GRID;
+
+        add("Calc_Perlin", "scalar", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) { return p->Calc_Perlin(0, x / 16, y / 16); }));
+        add("Perlin_Val", "scalar", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) { return p->Perlin_Val(x, y); }));
+        for (int level = PERLIN_SIMD_SCALAR; level <= detected; level++)
+        {
+            Perlin_Simd_Level() = level;
+            add("Perlin_Val", std::string("batch-") + levels[level], modes[mode], grid,
+                SAMPLE_SIDE, SAMPLE_SIDE,
+                batch_rows(grid, [p](const double *xs, const double *ys, double *out, int count) {
+                    p->Perlin_Val_Batch(xs, ys, out, count);
+                }));
+        }
+        Perlin_Simd_Level() = detected;
+
+        add("BasicPerlin<double>::Perlin_Val", "template", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [pd](double x, double y) { return pd->Perlin_Val(x, y); }));
+        add("BasicPerlin<float>::Perlin_Val", "template", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [pf](double x, double y) { return (double)pf->Perlin_Val((float)x, (float)y); }));
+
+        /* Warped ridged fbm, as a terrain generator would compose it */
+        auto terrain = warp(ridged(fbm<5>(gradient_noise<double>(mode), 1.0 / 16)),
+                            fbm<3>(gradient_noise<double, 1>(mode), 1.0 / 64),
+                            fbm<3>(gradient_noise<double, 2>(mode), 1.0 / 64), 8.0);
+        add("Warped ridged fbm", "expression", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [terrain](double x, double y) { return terrain.Value(x, y); }));
+
+        /* Value and gradient: analytic against forward differences */
+        add("Perlin_Val finite difference gradient", "scalar", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) {
+                double v = p->Perlin_Val(x, y);
+                return v + p->Perlin_Val(x + 1e-4, y) + p->Perlin_Val(x, y + 1e-4);
+            }));
+        add("Perlin_ValDeriv", "scalar", modes[mode], grid, SAMPLE_SIDE, SAMPLE_SIDE,
+            scalar_rows(grid, [p](double x, double y) {
+                double dx, dy;
+                return p->Perlin_ValDeriv(x, y, &dx, &dy) + dx + dy;
+            }));
+    }
+}
+
+/*
+ * Effects:
+ *      Returns the name of the first batch kernel whose results differ in any
+ *      bit from the scalar lanes, or NULL if every supported instruction set
+ *      agrees. Perlin_Val is checked in every gradient and hash mode.
+ */
+static const char *check_simd_lanes()
+{
+    const char *levels[3] = {"scalar", "sse41", "avx2"};
+    const int detected = Perlin_Simd_Detect();
+    const int count = 1024;
+    const char *failed = NULL;
+
+    /* Every lane count leaves a scalar tail on an odd count */
+    std::vector<double> xs(count - 1), ys(count - 1);
+    for (int i = 0; i < count - 1; i++)
+    {
+        xs[i] = (i % 32) * 7.3 + 0.11;
+        ys[i] = (i / 32) * 5.9 + 0.37;
+    }
+    std::vector<double> want[3], got[3];
+    for (int k = 0; k < 3; k++)
+    {
+        want[k].resize(count - 1);
+        got[k].resize(count - 1);
+    }
+    auto differs = [&](int k) {
+        return std::memcmp(want[k].data(), got[k].data(), want[k].size() * sizeof(double)) != 0;
+    };
+
+    Perlin perlin(DEFAULT_GRID, DEFAULT_GRID, 1);
+    Worley worley(32, 32, 1);
+    for (int level = PERLIN_SIMD_SSE41; level <= detected && !failed; level++)
+    {
+        for (int mode = 0; mode < 4 && !failed; mode++)
+        {
+            perlin.GradientMode = mode & 1 ? PERLIN_GRADIENT_TABLE : PERLIN_GRADIENT_ANGLE;
+            perlin.HashMode = mode & 2 ? PERLIN_HASH_MIX : PERLIN_HASH_PRIME;
+            Perlin_Simd_Level() = PERLIN_SIMD_SCALAR;
+            perlin.Perlin_Val_Batch(xs.data(), ys.data(), want[0].data(), count - 1);
+            Perlin_Simd_Level() = level;
+            perlin.Perlin_Val_Batch(xs.data(), ys.data(), got[0].data(), count - 1);
+            if (differs(0))
+                failed = "Perlin_Val_Batch";
+        }
+
+        Perlin_Simd_Level() = PERLIN_SIMD_SCALAR;
+        perlin.Perlin_Marble_Batch(xs.data(), ys.data(), want[0].data(), count - 1);
+        Perlin_Simd_Level() = level;
+        perlin.Perlin_Marble_Batch(xs.data(), ys.data(), got[0].data(), count - 1);
+        if (!failed && differs(0))
+            failed = "Perlin_Marble_Batch";
+
+        /* Worley wants coordinates inside its cells */
+        std::vector<double> cx(count - 1), cy(count - 1);
+        for (int i = 0; i < count - 1; i++)
+        {
+            cx[i] = std::fmod(xs[i], worley.CellsX);
+            cy[i] = std::fmod(ys[i], worley.CellsY);
+        }
+        Perlin_Simd_Level() = PERLIN_SIMD_SCALAR;
+        worley.Worley_Batch(cx.data(), cy.data(), want[0].data(), want[1].data(), want[2].data(), count - 1);
+        Perlin_Simd_Level() = level;
+        worley.Worley_Batch(cx.data(), cy.data(), got[0].data(), got[1].data(), got[2].data(), count - 1);
+        if (!failed && (differs(0) || differs(1) || differs(2)))
+            failed = "Worley_Batch";
+
+        if (failed)
+            std::fprintf(stderr, "%s on %s differs from the scalar lanes\n", failed, levels[level]);
+    }
+    Perlin_Simd_Level() = detected;
+    return failed;
+}
+
+/* Prints the results as a table */
+static void print_table(const std::vector<Result> &results)
+{
+    std::printf("%-38s %-14s %-6s %5s %7s %10s %14s %10s\n", "function", "path", "grad",
+                "grid", "threads", "ns/sample", "samples/s", "cyc/sample");
+    for (const Result &r : results)
+        std::printf("%-38s %-14s %-6s %5d %7d %10.2f %14.0f %10.1f\n", r.function.c_str(),
+                    r.path.c_str(), r.gradient.c_str(), r.grid, r.threads, r.nsPerSample,
+                    1e9 / r.nsPerSample, r.cyclesPerSample);
+}
+
+/* Prints the results as a JSON document */
+static void print_json(const std::vector<Result> &results, int threads)
+{
+    const char *levels[3] = {"scalar", "sse41", "avx2"};
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"perlin\",\n");
+    std::printf("  \"sample_side\": %d,\n", SAMPLE_SIDE);
+    std::printf("  \"repeats\": %d,\n", REPEATS);
+    std::printf("  \"threads\": %d,\n", threads);
+    std::printf("  \"simd\": \"%s\",\n", levels[Perlin_Simd_Detect()]);
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        std::printf("    {\"function\": \"%s\", \"path\": \"%s\", \"gradient\": \"%s\", "
+                    "\"grid\": %d, \"threads\": %d, \"ns_per_sample\": %.3f, "
+                    "\"samples_per_second\": %.0f, \"cycles_per_sample\": %.2f}%s\n",
+                    r.function.c_str(), r.path.c_str(), r.gradient.c_str(), r.grid, r.threads,
+                    r.nsPerSample, 1e9 / r.nsPerSample, r.cyclesPerSample,
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    int threads = (int)ThreadPool::Default_Threads();
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            /* A positive whole number, nothing after it */
+            char *end;
+            long parsed = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || parsed < 1 || parsed > MAX_THREADS)
+            {
+                std::fprintf(stderr, "%s: --threads takes a number from 1 to %d\n", argv[0], MAX_THREADS);
+                return 2;
+            }
+            threads = (int)parsed;
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--json] [--threads N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /*
+     * With the default primes of seed 0, Perlin_Val runs on BasicPerlin and must
+     * match the octave loop it replaces exactly, in every hash and gradient mode
+     */
+    Perlin perlin(256, 256, 0);
+    for (int mode = 0; mode < 4; mode++)
+    {
+        perlin.HashMode = mode / 2;
+        perlin.GradientMode = mode % 2;
+        for (int y = 0; y < 64; y++)
+        {
+            for (int x = 0; x < 64; x++)
+            {
+                double octaves = 0;
+                for (int i = 0; i <= 4; i++)
+                    octaves += perlin.Calc_Perlin(i, x * 3.7 / (1 << (4 + i)), y * 1.3 / (1 << (4 + i))) / (1 << i);
+                if (perlin.Perlin_Val(x * 3.7, y * 1.3) != octaves)
+                {
+                    std::fprintf(stderr, "BasicPerlin<double> differs from Perlin_Val at (%d, %d)\n", x, y);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    /* Every instruction set must agree with the scalar lanes bit for bit */
+    if (check_simd_lanes())
+        return 1;
+
+    /* Single thread on the calling thread, then the whole pool */
+    std::vector<Result> results;
+    run_all(NULL, results);
+    if (threads > 1)
+    {
+        ThreadPool pool(threads);
+        run_all(&pool, results);
+    }
+
+    if (json)
+        print_json(results, threads);
+    else
+        print_table(results);
+    return 0;
+}
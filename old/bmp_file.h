@@ -0,0 +1,173 @@
+/* Header file for reading bmp textures straight from a memory mapped file */
+
+#ifndef BMP_FILE_H
+#define BMP_FILE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "mapped_file.h"
+
+/*
+ * Uncompressed 24 or 32 bit bmp file mapped into memory.
+ *
+ * The header is validated against the size of the file, and Pixels points
+ * at the pixel rows inside the mapping, so Upload hands them to GL without
+ * any intermediate copy. Rows are padded to four bytes, which is GL's
+ * default unpack alignment, and bottom-up rows match GL's bottom-left
+ * texture origin.
+ */
+class BmpFile
+{
+public:
+    int Width = 0;
+    int Height = 0;
+    int BytesPerPixel = 0;              /* 3 for BGR, 4 for BGRA */
+    int Stride = 0;                     /* Bytes between rows, including padding */
+    bool TopDown = false;               /* First stored row is the top of the image */
+    const unsigned char *Pixels = NULL; /* First stored row, NULL if the file is unusable */
+    const char *Error = NULL;           /* Why the file is unusable */
+
+    /*
+     * Effects:
+     *      Maps filename and validates its headers. On failure Pixels is
+     *      NULL and Error describes the problem.
+     */
+    explicit BmpFile(const char *filename) : File(new MappedFile(filename))
+    {
+        Data = File->Data;
+        Size = File->Size;
+        if (!Data)
+        {
+            Error = "cannot open or map file";
+            return;
+        }
+        Error = Parse();
+        if (Error)
+            Pixels = NULL;
+    }
+
+    /*
+     * Requires:
+     *      data holds size bytes of a file and outlives this object.
+     *
+     * Effects:
+     *      Validates the headers of a file that is already in memory, such as
+     *      an asset of a mapped archive, without copying it. On failure
+     *      Pixels is NULL and Error describes the problem.
+     */
+    BmpFile(const unsigned char *data, size_t size) : Data(data), Size(size)
+    {
+        Error = Parse();
+        if (Error)
+            Pixels = NULL;
+    }
+
+    BmpFile(const BmpFile &) = delete;
+    BmpFile &operator=(const BmpFile &) = delete;
+
+    /*
+     * Requires:
+     *      Pixels is not NULL and a texture is bound to GL_TEXTURE_2D on the
+     *      active unit.
+     *
+     * Effects:
+     *      Uploads the image as level 0 of the bound texture directly from
+     *      the mapping. The unpack alignment and row length are set for the
+     *      padded rows and restored afterwards.
+     */
+    void Upload() const
+    {
+        int alignment, rowLength;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, Width);
+
+        GLenum format = BytesPerPixel == 4 ? GL_BGRA : GL_BGR;
+        GLenum internalFormat = BytesPerPixel == 4 ? GL_RGBA : GL_RGB;
+        if (!TopDown)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, GL_UNSIGNED_BYTE, Pixels);
+        }
+        else
+        {
+            /* GL has no negative stride, so flip one row at a time, still without copying */
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, GL_UNSIGNED_BYTE, NULL);
+            for (int row = 0; row < Height; row++)
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, Height - 1 - row, Width, 1, format, GL_UNSIGNED_BYTE,
+                                Pixels + (size_t)row * Stride);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    }
+
+private:
+    std::unique_ptr<MappedFile> File;   /* Mapping of the file, unless given its data */
+    const unsigned char *Data = NULL;
+    size_t Size = 0;
+
+    /* Little endian fields of the headers */
+    uint32_t U16(size_t at) const
+    {
+        return Data[at] | (uint32_t)Data[at + 1] << 8;
+    }
+
+    uint32_t U32(size_t at) const
+    {
+        return U16(at) | U16(at + 2) << 16;
+    }
+
+    /* Validates the headers and locates the pixels, returns NULL or an error */
+    const char *Parse()
+    {
+        /* File header followed by at least a BITMAPINFOHEADER */
+        if (Size < 54 || Data[0] != 'B' || Data[1] != 'M')
+            return "not a bmp file";
+        uint32_t offset = U32(10);
+        uint32_t infoSize = U32(14);
+        if (infoSize < 40 || 14 + (size_t)infoSize > Size)
+            return "unsupported info header";
+
+        int32_t width = (int32_t)U32(18);
+        int32_t height = (int32_t)U32(22);
+        uint32_t planes = U16(26);
+        uint32_t bits = U16(28);
+        uint32_t compression = U32(30);
+        if (width <= 0 || height == 0 || height == INT32_MIN || planes != 1)
+            return "invalid dimensions";
+        if (bits != 24 && bits != 32)
+            return "only 24 and 32 bit images are supported";
+
+        /* Uncompressed, or 32 bit with the BGRA masks GL_BGRA expects */
+        if (compression == 3 && bits == 32)
+        {
+            if (Size < 66 || U32(54) != 0x00ff0000u || U32(58) != 0x0000ff00u || U32(62) != 0x000000ffu)
+                return "unsupported bit fields";
+        }
+        else if (compression != 0)
+        {
+            return "compressed images are not supported";
+        }
+
+        /* Rows are padded to four bytes, and must all lie inside the file */
+        uint64_t stride = ((uint64_t)width * (bits / 8) + 3) & ~(uint64_t)3;
+        uint64_t rows = height < 0 ? -(int64_t)height : height;
+        if (offset < 14 + infoSize || offset + stride * rows > Size)
+            return "pixel data outside the file";
+
+        Width = width;
+        Height = (int)rows;
+        BytesPerPixel = (int)bits / 8;
+        Stride = (int)stride;
+        TopDown = height < 0;
+
+        Pixels = Data + offset;
+        return NULL;
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+/* Header file for reading baked BC1 textures straight from a memory mapped file */
+
+#ifndef DDS_FILE_H
+#define DDS_FILE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+#include <cstring>
+
+#include "mapped_file.h"
+
+/* From GL_EXT_texture_compression_s3tc, which the loader does not list */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+/*
+ * DDS file holding a full mip chain of BC1 (DXT1) blocks, as written by
+ * bake_textures. BC1 stores every 4x4 block of texels in 8 bytes, a sixth of
+ * 24 bit RGB, and the mips are baked offline, so Upload passes the mapped
+ * blocks of every level to glCompressedTexImage2D and nothing is filtered or
+ * converted at load time.
+ *
+ * Block rows are stored bottom-up, in GL's order, so the file uploads as is.
+ */
+class DdsFile
+{
+public:
+    static const int HEADER_SIZE = 128;     /* "DDS " followed by the 124 byte header */
+    static const int BLOCK_SIZE = 8;        /* Bytes of one BC1 block */
+    static const int MAX_LEVELS = 32;
+
+    int Width = 0;
+    int Height = 0;
+    int Levels = 0;                         /* Mip levels, 1 for level 0 only */
+    size_t DataSize = 0;                    /* Bytes of all levels together */
+    const unsigned char *Blocks = NULL;     /* Level 0, the others follow it, NULL if unusable */
+    const char *Error = NULL;               /* Why the file is unusable */
+
+    /*
+     * Effects:
+     *      Maps filename and validates its header. On failure Blocks is NULL
+     *      and Error describes the problem.
+     */
+    explicit DdsFile(const char *filename) : File(new MappedFile(filename))
+    {
+        Data = File->Data;
+        Size = File->Size;
+        if (!Data)
+        {
+            Error = "cannot open or map file";
+            return;
+        }
+        Error = Parse();
+        if (Error)
+            Blocks = NULL;
+    }
+
+    /*
+     * Requires:
+     *      data holds size bytes of a file and outlives this object.
+     *
+     * Effects:
+     *      Validates the header of a file that is already in memory, such as
+     *      an asset of a mapped archive, without copying it. On failure
+     *      Blocks is NULL and Error describes the problem.
+     */
+    DdsFile(const unsigned char *data, size_t size) : Data(data), Size(size)
+    {
+        Error = Parse();
+        if (Error)
+            Blocks = NULL;
+    }
+
+    DdsFile(const DdsFile &) = delete;
+    DdsFile &operator=(const DdsFile &) = delete;
+
+    /* Returns the bytes of BC1 blocks covering a width x height level */
+    static size_t Level_Size(int width, int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BLOCK_SIZE;
+    }
+
+    /* Returns whether the current GL context can sample BC1 textures */
+    static bool Supported()
+    {
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++)
+        {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+     * Requires:
+     *      Blocks is not NULL, a texture is bound to GL_TEXTURE_2D on the
+     *      active unit and Supported() holds. base is Blocks, or the offset
+     *      of a copy of them in a bound pixel unpack buffer.
+     *
+     * Effects:
+     *      Uploads every level of the bound texture and limits its mip
+     *      chain to them.
+     */
+    void Upload(const void *base) const
+    {
+        const unsigned char *level = (const unsigned char *)base;
+        for (int i = 0; i < Levels; i++)
+        {
+            int width = Width >> i > 0 ? Width >> i : 1;
+            int height = Height >> i > 0 ? Height >> i : 1;
+            GLsizei size = (GLsizei)Level_Size(width, height);
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, width, height, 0, size, level);
+            level += size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Levels - 1);
+    }
+
+private:
+    std::unique_ptr<MappedFile> File;   /* Mapping of the file, unless given its data */
+    const unsigned char *Data = NULL;
+    size_t Size = 0;
+
+    /* Little endian field of the header */
+    uint32_t U32(size_t at) const
+    {
+        return Data[at] | (uint32_t)Data[at + 1] << 8 |
+               (uint32_t)Data[at + 2] << 16 | (uint32_t)Data[at + 3] << 24;
+    }
+
+    /* Validates the header and locates the blocks, returns NULL or an error */
+    const char *Parse()
+    {
+        if (Size < HEADER_SIZE || memcmp(Data, "DDS ", 4) != 0 || U32(4) != 124)
+            return "not a dds file";
+        if ((U32(80) & 0x4) == 0 || memcmp(Data + 84, "DXT1", 4) != 0)
+            return "only BC1 (DXT1) blocks are supported";
+
+        uint32_t height = U32(12);
+        uint32_t width = U32(16);
+        uint32_t levels = U32(28) ? U32(28) : 1;
+        if (width == 0 || height == 0 || width > 65536 || height > 65536 || levels > MAX_LEVELS)
+            return "invalid dimensions";
+
+        /* Every level must be inside the file */
+        size_t size = 0;
+        for (uint32_t i = 0; i < levels; i++)
+        {
+            uint32_t levelWidth = width >> i > 0 ? width >> i : 1;
+            uint32_t levelHeight = height >> i > 0 ? height >> i : 1;
+            size += Level_Size((int)levelWidth, (int)levelHeight);
+        }
+        if (HEADER_SIZE + size > Size)
+            return "blocks outside the file";
+
+        Width = (int)width;
+        Height = (int)height;
+        Levels = (int)levels;
+        DataSize = size;
+        Blocks = Data + HEADER_SIZE;
+        return NULL;
+    }
+};
+
+#endif
@@ -0,0 +1,61 @@
+/* Header file for baking the tiling fog density volume */
+
+#ifndef FOG_VOLUME_H
+#define FOG_VOLUME_H
+
+#include <vector>
+
+#include "perlin.h"
+#include "thread_pool.h"
+
+/* Fog volume settings */
+const int FOG_VOLUME_OCTAVES = 3;        // Octaves of tiled noise summed per voxel
+const double FOG_VOLUME_CONTRAST = 3.0;  // Spread of densities around the mean, higher is patchier
+
+/*
+ * Requires:
+ *      side and cells are positive.
+ *
+ * Effects:
+ *      Returns a side x side x side volume of fog densities between 0 and
+ *      255, x fastest then y then z. The coarsest octave has cells noise
+ *      cells across the volume and every octave repeats with the volume, so
+ *      it tiles seamlessly along every axis. Slices are baked in parallel
+ *      on pool.
+ */
+inline std::vector<unsigned char> bake_fog_volume(const Perlin &perlin, int side, int cells, ThreadPool &pool)
+{
+    std::vector<unsigned char> volume((size_t)side * side * side);
+
+    pool.Parallel_For(0, side, 1, [&](int start, int end) {
+        for (int z = start; z < end; z++)
+        {
+            unsigned char *slice = volume.data() + (size_t)z * side * side;
+            for (int y = 0; y < side; y++)
+            {
+                for (int x = 0; x < side; x++)
+                {
+                    /* Sum the octaves, each with twice the cells of the last */
+                    double total = 0, ampl = 1, weight = 0;
+                    for (int i = 0; i < FOG_VOLUME_OCTAVES; i++)
+                    {
+                        int period = cells << i;
+                        double scale = (double)period / side;
+                        total += perlin.Calc_Perlin3_Tiled(i, x * scale, y * scale, z * scale, period) / ampl;
+                        weight += 1 / ampl;
+                        ampl *= 2;
+                    }
+
+                    /* Stretch around the mean so the fog gathers into banks */
+                    double density = (total / weight - 0.5) * FOG_VOLUME_CONTRAST + 0.5;
+                    density = density < 0 ? 0 : (density > 1 ? 1 : density);
+                    slice[y * side + x] = (unsigned char)(density * 255 + 0.5);
+                }
+            }
+        }
+    });
+
+    return volume;
+}
+
+#endif
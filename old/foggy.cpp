@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <glad/glad.h> 
 #include <cmath>
+#include <cstring>
+#include <vector>
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
@@ -10,6 +12,9 @@
 
 #include "shaders/shader_s.h"
 #include "controlledCamera.h"
+#include "fog_volume.h"
+#include "worley.h"
+#include "texture_loader.h"
 
 typedef struct {
     int width;
@@ -21,13 +26,21 @@ typedef struct {
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void handleInput(GLFWwindow *window, float delta, glm::vec3 *pillarPositions, unsigned int pillarInstances);
-int bind_texture(char* textureFilename, int glTexture);
-Image readBMP(char* filename);
+int bind_fog_volume(int glTexture);
+int upload_layer(Image image, unsigned int array, int layer);
+void append_mesh(std::vector<float> &vertices, std::vector<unsigned int> &indices,
+                 const float *mesh, int meshVertices, int stride,
+                 const unsigned int *meshIndices, int meshIndexCount, int meshId);
+void append_instance(std::vector<float> &instances, const glm::mat4 &model, int layer, int meshId);
+Image generate_stone_texture(int height, int width, uint64_t seed);
 
 //  Window Settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
 
+// Shaders and textures, mapped once at startup, loose files if not packed
+AssetArchive assets("assets.pak");
+
 // Camera values
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float prevMouseX = SCR_WIDTH / 2;
@@ -44,6 +57,27 @@ const float PILLAR_HEIGHT = 60.0f;
 const float CUBE_SCALE = 40.0f;
 const float CUBE_HEIGHT = 3.0f;
 const glm::vec3 FOG_COLOR = glm::vec3(0.7f, 0.7f, 0.7f);
+const int FOG_VOLUME_SIDE = 64;       // Voxels along each side of the fog density volume
+const int FOG_VOLUME_CELLS = 4;       // Noise cells across the volume in its coarsest octave
+const float FOG_TILE_SIZE = 96.0f;    // World units covered by one tile of the volume
+const glm::vec3 FOG_SCROLL = glm::vec3(0.004f, 0.001f, 0.0025f); // Tiles per second the fog drifts
+const uint64_t FOG_SEED = 7;          // Seed of the fog density noise
+const int MATERIAL_SIZE = 512;        // Width and height of every layer of the material array
+const int MATERIAL_GROUND = 0;        // Layers of the material array
+const int MATERIAL_WOOD = 1;
+const int MATERIAL_STONE = 2;
+const int MATERIAL_LAYERS = 3;
+const int MESH_CUBE = 0;              // Meshes of the scene geometry
+const int MESH_PILLAR = 1;
+const int MESH_GROUND = 2;
+const int MESH_STRIDE = 9;            // Floats per scene vertex: position, uv, normal and mesh
+const int INSTANCE_STRIDE = 18;       // Floats per instance: model matrix, layer and mesh
+const int MAX_INSTANCES = PILLAR_COUNT * PILLAR_COUNT + 2; // Every pillar, the cube and the ground
+const int STONE_SIZE = MATERIAL_SIZE; // Width and height of the stone texture
+const double STONE_CELL_SIZE = 96.0;  // Approximate pixels across one stone
+const double STONE_CRACK_WIDTH = 0.12; // Width of the cracks between stones, in cells
+const uint64_t STONE_SEED = 11;       // Seed of the stone layout
+const int STONE_COLOR[3] = {118, 126, 134}; // Stone color in blue, green, red order
 
 using namespace std;
 
@@ -81,7 +115,7 @@ int main() {
     } 
 
     /* Building and compiling shaders */
-    Shader mainShader("shaders/fogshader.vs", "shaders/fogshadercube.fs");
+    Shader mainShader(assets, "shaders/fogshader.vs", "shaders/fogshadercubes.fs");
 
     /* Enable vertex depth */
     glEnable(GL_DEPTH_TEST);  
@@ -183,91 +217,93 @@ int main() {
     /* Number of pillars to draw */
     unsigned int pillarInstances = 0; 
 
-    /* Vertex array and buffer objects, alongside element buffer objects. */
-    unsigned int VBO[3], VAO[3], EBO[3];
-    glGenVertexArrays(3, VAO);
-    glGenBuffers(3, VBO);
-    glGenBuffers(3, EBO);
-
-
-    /* Binding VAO used for the ground */
-    glBindVertexArray(VAO[0]);
-
-    /* Configuring vertex and indice data */
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO[0]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(groundIndices), groundIndices, GL_STATIC_DRAW);
-
-    // Getting position vectors
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Getting texture vectors
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Getting normal vectors 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    /* Binding VAO used for pillars */
-    glBindVertexArray(VAO[1]);
-
-    /* Configuring vertex and indice data */
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pillarVertices), pillarVertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(pillarIndices), pillarIndices, GL_STATIC_DRAW);
+    /*
+     * The meshes are uploaded once, each vertex tagged with its mesh. Every
+     * object is an instance with its model matrix, material layer and mesh,
+     * so the whole scene is a single instanced draw whatever mix of meshes
+     * and materials is in view.
+     */
+    std::vector<float> sceneVertices;
+    std::vector<unsigned int> sceneIndices;
+    append_mesh(sceneVertices, sceneIndices, cubeVertices, sizeof(cubeVertices) / (5 * sizeof(float)), 5,
+                cubeIndices, sizeof(cubeIndices) / sizeof(cubeIndices[0]), MESH_CUBE);
+    append_mesh(sceneVertices, sceneIndices, pillarVertices, sizeof(pillarVertices) / (8 * sizeof(float)), 8,
+                pillarIndices, sizeof(pillarIndices) / sizeof(pillarIndices[0]), MESH_PILLAR);
+    append_mesh(sceneVertices, sceneIndices, groundVertices, sizeof(groundVertices) / (8 * sizeof(float)), 8,
+                groundIndices, sizeof(groundIndices) / sizeof(groundIndices[0]), MESH_GROUND);
+
+    /* Vertex array, static scene buffers and the instance buffer refilled every frame */
+    unsigned int VBO, VAO, EBO, instanceVBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &instanceVBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sceneVertices.size() * sizeof(float), sceneVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sceneIndices.size() * sizeof(unsigned int), sceneIndices.data(), GL_STATIC_DRAW);
 
     // Getting position vectors
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MESH_STRIDE * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     // Getting texture vectors
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, MESH_STRIDE * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    // Getting normal vectors 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+    // Getting normal vectors
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, MESH_STRIDE * sizeof(float), (void*)(5 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    /* Binding VAO used for cubes */
-    glBindVertexArray(VAO[2]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO[2]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
-
-    // Getting position vectors
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Getting texture vectors
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Getting normal vectors 
-    //glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-    //glEnableVertexAttribArray(2);
+    // Getting the mesh of every vertex
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, MESH_STRIDE * sizeof(float), (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    /* Configuring instancing data, the model matrix takes four columns */
+    std::vector<float> instances;
+    instances.reserve(MAX_INSTANCES * INSTANCE_STRIDE);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, MAX_INSTANCES * INSTANCE_STRIDE * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    for (int column = 0; column < 4; column++) {
+        glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE * sizeof(float),
+                              (void*)(4 * column * sizeof(float)));
+        glVertexAttribDivisor(4 + column, 1);
+        glEnableVertexAttribArray(4 + column);
+    }
+    glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE * sizeof(float), (void*)(16 * sizeof(float)));
+    glVertexAttribDivisor(8, 1);
+    glEnableVertexAttribArray(8);
+    glVertexAttribPointer(9, 1, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE * sizeof(float), (void*)(17 * sizeof(float)));
+    glVertexAttribDivisor(9, 1);
+    glEnableVertexAttribArray(9);
 
     /* Configuring shader textures */
     mainShader.use();
 
+    /* Textures load in the background, with placeholders bound until then */
+    TextureLoader textures(&assets);
+
+    /* Every material is a layer of one array */
+    unsigned int materials = textures.Create_Array(MATERIAL_SIZE, MATERIAL_LAYERS, GL_TEXTURE0);
+    mainShader.setInt("materials", 0);
+
     /* Generate texture for ground */
-    bind_texture((char *)"textures/ground_texture.bmp", GL_TEXTURE0);
+    textures.Load_Layer("textures/ground_texture.bmp", materials, MATERIAL_GROUND, MATERIAL_SIZE);
 
     /* Generate texture for the pillars */
-    bind_texture((char *)"textures/wood_texture.bmp", GL_TEXTURE1);
+    textures.Load_Layer("textures/wood_texture.bmp", materials, MATERIAL_WOOD, MATERIAL_SIZE);
 
     /* Generate texture for the cubes */
-    bind_texture((char *)"textures/stone_texture.bmp", GL_TEXTURE2);
+    upload_layer(generate_stone_texture(STONE_SIZE, STONE_SIZE, STONE_SEED), materials, MATERIAL_STONE);
+
+    /* Generate density volume for the fog */
+    bind_fog_volume(GL_TEXTURE1);
 
     /* Fog color and other values */
     mainShader.setVec3("fogColor", FOG_COLOR);
+    mainShader.setInt("fogVolume", 1);
+    mainShader.setFloat("fogTileSize", FOG_TILE_SIZE);
     mainShader.setFloat("cubeSize", CUBE_SCALE);
     mainShader.setFloat("cubeHeight", CUBE_HEIGHT);
 
@@ -280,6 +316,9 @@ int main() {
      */
     while (!glfwWindowShouldClose(window))
     {
+        /* Swap in textures that finished loading */
+        textures.Poll();
+
         /* Calculating delta */
         float currentFrame = static_cast<float>(glfwGetTime());
         delta = currentFrame - prevFrame;
@@ -333,7 +372,6 @@ int main() {
             projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
             /* Store transformation data locations */
-            unsigned int modelLoc = glGetUniformLocation(mainShader.ID, "model");
             unsigned int viewLoc  = glGetUniformLocation(mainShader.ID, "view");
             unsigned int projLoc  = glGetUniformLocation(mainShader.ID, "projection");
             unsigned int lightIntensityLoc  = glGetUniformLocation(mainShader.ID, "lightIntensity");
@@ -342,14 +380,12 @@ int main() {
             glUniform1f(lightIntensityLoc, 0.9f);
             mainShader.setVec3("viewSource", camera.Position);
 
-            /* Use main shader */
-            mainShader.use();
-
-            /* Bind VAO used for the cubes */
-            glBindVertexArray(VAO[2]);
+            /* Drift the fog, wrapped to one tile to keep precision */
+            glm::vec3 fogOffset = glm::fract((float)glfwGetTime() * FOG_SCROLL);
+            mainShader.setVec3("fogOffset", fogOffset);
 
-            /* Set active texture for ground */
-            glUniform1i(glGetUniformLocation(mainShader.ID, "textureID"), 2);
+            /* Every object is an instance */
+            instances.clear();
 
             /* Find nearest large block */
             cameraCubeSnapX = (int) camera.GetPosition().x;
@@ -364,26 +400,16 @@ int main() {
             model = glm::translate(model, glm::vec3(0.0f, CUBE_SCALE / 2 + 3.0f, 0.0f));
             /* Translate with time */
             model = glm::translate(model, glm::vec3(fmod((float) glfwGetTime() + 50, 200.0f) - 100 + cameraCubeSnapX, 0.0f, cameraCubeSnapZ));
-            
-            /* Resize*/ 
-            model = glm::scale(model, glm::vec3(CUBE_SCALE, CUBE_SCALE, CUBE_SCALE));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 
-            /* Draw triangle*/
-            glDrawElements(GL_TRIANGLES, 30, GL_UNSIGNED_INT, 0);
+            /* Resize*/
+            model = glm::scale(model, glm::vec3(CUBE_SCALE, CUBE_SCALE, CUBE_SCALE));
+            append_instance(instances, model, MATERIAL_STONE, MESH_CUBE);
 
             /* Store cube data into shaders */
-            mainShader.setVec3("cubePos", 
+            mainShader.setVec3("cubePos",
                 glm::vec3(fmod((float) glfwGetTime() + 50, 200.0f) - 100 + cameraCubeSnapX, 0.0f, cameraCubeSnapZ));
-            
-
-            /* Bind VAO used for objects */
-            glBindVertexArray(VAO[1]); 
 
-            /* Set active texture for pillars */
-            glUniform1i(glGetUniformLocation(mainShader.ID, "textureID"), 1);
-
-            /* Draw each cube */
+            /* Add each pillar */
             for (unsigned int i = 0; i < pillarInstances; i++) {
                 /* Generate model transformations */
                 glm::mat4 model = glm::mat4(1.0f);
@@ -392,31 +418,29 @@ int main() {
                 model = glm::translate(model, pillarPositions[i]);
                 model = glm::translate(model, glm::vec3(0.0f, PILLAR_HEIGHT / 2 - 1.0f, 0.0f));
                 model = glm::scale(model, glm::vec3(PILLAR_WIDTH, PILLAR_HEIGHT, PILLAR_WIDTH));
-                
-                /* Pass model transformation to shaders. */
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 
-                /* Draw triangles, not including top or bottom since invisible. */
-                glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, 0);
+                /* Not including top or bottom since invisible. */
+                append_instance(instances, model, MATERIAL_WOOD, MESH_PILLAR);
             }
 
-
-            /* Bind VAO used for the ground*/
-            glBindVertexArray(VAO[0]);
-
-            /* Set active texture for ground */
-            glUniform1i(glGetUniformLocation(mainShader.ID, "textureID"), 0);
-
             /* Always center ground righ below camera */
             model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, -2.0f, 0.0f));
             model = glm::translate(model, glm::vec3(cameraSnapX, 0.0f, cameraSnapZ));
             /* Resize */
             model = glm::scale(model, glm::vec3(GROUND_SCALE, 1.0, GROUND_SCALE));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            append_instance(instances, model, MATERIAL_GROUND, MESH_GROUND);
+
+            /* Map into buffer */
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            void *ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+            memcpy(ptr, instances.data(), instances.size() * sizeof(float));
+            glUnmapBuffer(GL_ARRAY_BUFFER);
 
-            /* Draw triangle*/
-            glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+            /* Draw every mesh and material at once */
+            glBindVertexArray(VAO);
+            glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)sceneIndices.size(), GL_UNSIGNED_INT, 0,
+                                    (GLsizei)(instances.size() / INSTANCE_STRIDE));
 
             /* Swap buffers and poll events */
             glfwSwapBuffers(window);
@@ -425,11 +449,13 @@ int main() {
     }
 
     /* Deallocate resources */
-    glDeleteVertexArrays(3, VAO);
-    glDeleteBuffers(3, VBO);
-    glDeleteBuffers(3, EBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &instanceVBO);
     
-    /* Terminate glfw */
+    /* Terminate glfw once no loader thread uses the context */
+    textures.Wait();
     glfwTerminate();
     return 0;
 }
@@ -527,36 +553,132 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
-/* 
+/*
  *  Requires:
- *      This function should be provided a valid filename pointing to a bmp file.
- * 
+ *      image.data is NULL or a calloc'd square BGR image, and array a
+ *      texture array with layers of the same size.
+ *
  *  Effects:
- *      Reads the bmp file and returns the image data.
+ *      Uploads the image and the mips built from it to the given layer of
+ *      the array and frees the image data.
  */
-Image readBMP(char* filename)
+int upload_layer(Image image, unsigned int array, int layer)
 {
-    /* Open file */
-    FILE *f = fopen(filename, "rb");
+    unsigned char *data = image.data;
 
-    /* Reading header */
-    unsigned char header[54];
-    fread(header, sizeof(unsigned char), 54, f);
+    /* If succesfully loaded */
+    if (data) {
+        std::vector<unsigned char> chain(TextureLoader::Layer_Chain_Size(image.width));
+        memcpy(chain.data(), data, (size_t)image.width * image.height * 3);
+        TextureLoader::Build_Layer_Mips(chain.data(), image.width);
+        TextureLoader::Upload_Layer_Chain(array, layer, image.width, chain.data());
+    }
+    else {
+        std::cout << "Error when loading texture data" << std::endl;
+        return -1;
+    }
+    free(data);
+    return 0;
+}
 
-    /* Get height, width, and offset info */
-    int width = *(int*) &header[18];
-    int height = *(int*) &header[22];
-    int offset = *(int *) &header[10];
+/*
+ *  Requires:
+ *      mesh holds meshVertices vertices of stride floats, position and uv
+ *      followed by the normal if stride is 8, and meshIndices indexes them.
+ *
+ *  Effects:
+ *      Appends the mesh to the scene geometry, every vertex tagged with
+ *      meshId so only instances of that mesh draw it.
+ */
+void append_mesh(std::vector<float> &vertices, std::vector<unsigned int> &indices,
+                 const float *mesh, int meshVertices, int stride,
+                 const unsigned int *meshIndices, int meshIndexCount, int meshId)
+{
+    unsigned int first = (unsigned int)(vertices.size() / MESH_STRIDE);
+
+    for (int i = 0; i < meshVertices; i++) {
+        const float *vertex = mesh + i * stride;
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        if (stride >= 8) {
+            normal[0] = vertex[5];
+            normal[1] = vertex[6];
+            normal[2] = vertex[7];
+        }
+        float tagged[MESH_STRIDE] = {
+            vertex[0], vertex[1], vertex[2],
+            vertex[3], vertex[4],
+            normal[0], normal[1], normal[2],
+            (float)meshId,
+        };
+        vertices.insert(vertices.end(), tagged, tagged + MESH_STRIDE);
+    }
+    for (int i = 0; i < meshIndexCount; i++)
+        indices.push_back(first + meshIndices[i]);
+}
 
-    /* Going to beginning of pixel data */
-    fseek(f, offset, SEEK_SET);
+/*
+ *  Effects:
+ *      Appends an instance of the given mesh, placed by model and sampling
+ *      the given layer of the material array.
+ */
+void append_instance(std::vector<float> &instances, const glm::mat4 &model, int layer, int meshId)
+{
+    const float *matrix = glm::value_ptr(model);
+    instances.insert(instances.end(), matrix, matrix + 16);
+    instances.push_back((float)layer);
+    instances.push_back((float)meshId);
+}
 
+/*
+ *  Requires:
+ *      The width and height should be positive values.
+ *
+ *  Effects:
+ *      Generates a tiling stone texture with the given width and height from
+ *      cellular noise, one stone per feature point, with dark cracks where
+ *      two stones meet. Different seeds give different stone layouts.
+ */
+Image generate_stone_texture(int height, int width, uint64_t seed)
+{
     /* Create corresponding image size*/
-    unsigned char* data = (unsigned char*) calloc(3 * width * height, sizeof(unsigned char));
+    unsigned char *data = (unsigned char *)calloc(3 * width * height, sizeof(unsigned char));
+
+    /* Whole stones across the texture, so it tiles */
+    int cellsX = (int)lround(width / STONE_CELL_SIZE);
+    int cellsY = (int)lround(height / STONE_CELL_SIZE);
+    Worley worley(cellsX > 0 ? cellsX : 1, cellsY > 0 ? cellsY : 1, seed);
 
-    /* Read remaining image data and close file */
-    fread(data, sizeof(unsigned char), 3 * width * height, f);
-    fclose(f);
+    ThreadPool pool;
+    pool.Parallel_For(0, height, 16, [&](int start, int end) {
+        std::vector<double> xs(width), ys(width), f1(width), f2(width), cell(width);
+        for (int col = 0; col < width; col++)
+            xs[col] = (col + 0.5) * worley.CellsX / width;
+
+        for (int row = start; row < end; row++)
+        {
+            /* Nearest feature points of the whole row at once */
+            for (int col = 0; col < width; col++)
+                ys[col] = (row + 0.5) * worley.CellsY / height;
+            worley.Worley_Batch(xs.data(), ys.data(), f1.data(), f2.data(), cell.data(), width);
+
+            for (int col = 0; col < width; col++)
+            {
+                /* Each stone gets its own shade, darker away from its center */
+                double shade = 0.8 + 0.3 * (cell[col] - 0.5) - 0.25 * f1[col];
+
+                /* Darken towards the border with the next stone */
+                double edge = (f2[col] - f1[col]) / STONE_CRACK_WIDTH;
+                edge = edge > 1 ? 1 : edge;
+                double value = shade * (0.3 + 0.7 * edge);
+
+                for (int c = 0; c < 3; c++)
+                {
+                    double color = STONE_COLOR[c] * value;
+                    data[3 * (row * width + col) + c] = (unsigned char)(color > 255 ? 255 : color);
+                }
+            }
+        }
+    });
 
     /* Return Image data */
     Image image;
@@ -567,43 +689,39 @@ Image readBMP(char* filename)
     return image;
 }
 
-/* 
+/*
  *  Requires:
- *      This provided filename should be a valid bmp file and glTexture an integer
- *      corresponding to a gl texture.
- * 
+ *      glTexture an integer corresponding to a gl texture.
+ *
  *  Effects:
- *      Reads the bmp file binds it to the given gl texture.
+ *      Bakes the tiling fog density volume on every core and binds it to
+ *      the given gl texture as a 3D texture.
  */
-int bind_texture(char* textureFilename, int glTexture)
+int bind_fog_volume(int glTexture)
 {
-    unsigned int texture_ground;
-    glGenTextures(1, &texture_ground);
-    glActiveTexture(glTexture);
-    glBindTexture(GL_TEXTURE_2D, texture_ground);
-    /* Set texture wrapping */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    /* Load textures */
-    Image image = readBMP(textureFilename);
-    int width = image.width;
-    int height = image.height;
-    unsigned char *data = image.data;
+    /* Bake densities */
+    Perlin perlin = Perlin(1, 1, FOG_SEED);
+    ThreadPool pool;
+    std::vector<unsigned char> volume = bake_fog_volume(perlin, FOG_VOLUME_SIDE, FOG_VOLUME_CELLS, pool);
 
-    std::cout << "Reading texture with width " << width << " and height " << height << std::endl;
+    std::cout << "Baked fog volume with side " << FOG_VOLUME_SIDE << std::endl;
 
-    /* If succesfully loaded */
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Error when loading texture data" << std::endl;
-        return -1;
-    }
-    delete[] data;
+    unsigned int texture_fog;
+    glGenTextures(1, &texture_fog);
+    glActiveTexture(glTexture);
+    glBindTexture(GL_TEXTURE_3D, texture_fog);
+    /* Repeat along every axis, the volume tiles */
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    /* Single channel rows are not 4 byte aligned in general */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, FOG_VOLUME_SIDE, FOG_VOLUME_SIDE, FOG_VOLUME_SIDE, 0,
+                 GL_RED, GL_UNSIGNED_BYTE, volume.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_3D);
     return 0;
-}
\ No newline at end of file
+}
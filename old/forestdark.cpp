@@ -10,24 +10,20 @@
 
 #include "shaders/shader_s.h"
 #include "controlledCamera.h"
-
-typedef struct {
-    int width;
-    int height;
-    unsigned char* data;
-} Image;
+#include "texture_loader.h"
 
 // Function headings
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void handleInput(GLFWwindow *window, float delta, glm::vec3 *pillarPositions, unsigned int pillarInstances);
-int bind_texture(char* textureFilename, int glTexture);
-Image readBMP(char* filename);
 
 //  Window Settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
 
+// Shaders and textures, mapped once at startup, loose files if not packed
+AssetArchive assets("assets.pak");
+
 // Camera values
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float prevMouseX = SCR_WIDTH / 2;
@@ -81,7 +77,7 @@ int main() {
     } 
 
     /* Building and compiling shaders */
-    Shader mainShader("shaders/darkshader.vs", "shaders/darkshader.fs");
+    Shader mainShader(assets, "shaders/darkshader.vs", "shaders/darkshader.fs");
 
     /* Enable vertex depth */
     glEnable(GL_DEPTH_TEST);  
@@ -191,14 +187,17 @@ int main() {
     /* Configuring shader textures */
     mainShader.use();
 
+    /* Textures load in the background, with placeholders bound until then */
+    TextureLoader textures(&assets);
+
     /* Generate texture for ground */
-    bind_texture((char *)"textures/ground_texture.bmp", GL_TEXTURE0);
+    textures.Load("textures/ground_texture.dds", GL_TEXTURE0);
 
     /* Generate texture for the pillars */
-    bind_texture((char *)"textures/wood_texture.bmp", GL_TEXTURE1);
+    textures.Load("textures/wood_texture.dds", GL_TEXTURE1);
 
     /* Generate texture for the cubes */
-    bind_texture((char *)"textures/stone_texture.bmp", GL_TEXTURE2);
+    textures.Load("textures/stone_texture.dds", GL_TEXTURE2);
 
     /* Fog color and other values */
     mainShader.setVec3("fogColor", FOG_COLOR);
@@ -214,6 +213,9 @@ int main() {
      */
     while (!glfwWindowShouldClose(window))
     {
+        /* Swap in textures that finished loading */
+        textures.Poll();
+
         /* Calculating delta */
         float currentFrame = static_cast<float>(glfwGetTime());
         delta = currentFrame - prevFrame;
@@ -332,7 +334,8 @@ int main() {
     glDeleteBuffers(3, VBO);
     glDeleteBuffers(3, EBO);
     
-    /* Terminate glfw */
+    /* Terminate glfw once no loader thread uses the context */
+    textures.Wait();
     glfwTerminate();
     return 0;
 }
@@ -429,84 +432,3 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     /* Pass cursor movement to camera */
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
-
-/* 
- *  Requires:
- *      This function should be provided a valid filename pointing to a bmp file.
- * 
- *  Effects:
- *      Reads the bmp file and returns the image data.
- */
-Image readBMP(char* filename)
-{
-    /* Open file */
-    FILE *f = fopen(filename, "rb");
-
-    /* Reading header */
-    unsigned char header[54];
-    fread(header, sizeof(unsigned char), 54, f);
-
-    /* Get height, width, and offset info */
-    int width = *(int*) &header[18];
-    int height = *(int*) &header[22];
-    int offset = *(int *) &header[10];
-
-    /* Going to beginning of pixel data */
-    fseek(f, offset, SEEK_SET);
-
-    /* Create corresponding image size*/
-    unsigned char* data = (unsigned char*) calloc(3 * width * height, sizeof(unsigned char));
-
-    /* Read remaining image data and close file */
-    fread(data, sizeof(unsigned char), 3 * width * height, f);
-    fclose(f);
-
-    /* Return Image data */
-    Image image;
-    image.width = width;
-    image.height = height;
-    image.data = data;
-
-    return image;
-}
-
-/* 
- *  Requires:
- *      This provided filename should be a valid bmp file and glTexture an integer
- *      corresponding to a gl texture.
- * 
- *  Effects:
- *      Reads the bmp file binds it to the given gl texture.
- */
-int bind_texture(char* textureFilename, int glTexture)
-{
-    unsigned int texture_ground;
-    glGenTextures(1, &texture_ground);
-    glActiveTexture(glTexture);
-    glBindTexture(GL_TEXTURE_2D, texture_ground);
-    /* Set texture wrapping */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    /* Load textures */
-    Image image = readBMP(textureFilename);
-    int width = image.width;
-    int height = image.height;
-    unsigned char *data = image.data;
-
-    std::cout << "Reading texture with width " << width << " and height " << height << std::endl;
-
-    /* If succesfully loaded */
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Error when loading texture data" << std::endl;
-        return -1;
-    }
-    delete[] data;
-    return 0;
-}
\ No newline at end of file
@@ -18,6 +18,9 @@
 #include "camera.h"
 #include "perlin.h"
 #include "shapes.h"
+#include "thread_pool.h"
+#include "texture_cache.h"
+#include "virtual_texture.h"
 
 /* Namespace */
 using namespace std;
@@ -35,14 +38,25 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double mouseX, double mouseY);
 void handleInput(GLFWwindow *window, float delta);
 int bind_texture(int height, int width, int glTexture);
+int bake_texture_gpu(const Perlin &perlin, int height, int width, int levels);
+int check_texture_gpu(const Perlin &perlin, ThreadPool &pool, int height, int width);
+int texture_levels(int height, int width);
 Image readBMP(char *filename);
-Image generate_texture(int height, int width);
+Image generate_texture(const Perlin &perlin, ThreadPool &pool, int height, int width);
+Image generate_texture_level(const Perlin &perlin, ThreadPool &pool, int height, int width, int level);
+void generate_floor_tile(const Perlin &perlin, double x, double y, double step, int size, unsigned char *bgr);
 void bindArrays(unsigned int *VAOs, unsigned int *VBOs, unsigned int *instanceVBOs);
 
 /* Window Settings */
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
 
+/* Shaders and textures, mapped once at startup, loose files if not packed */
+AssetArchive assets("assets.pak");
+
+/* Generated textures kept between launches */
+TextureCache textureCache("cache");
+
 /* Camera Settings */
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f)); // Camera instance
 float prevMouseX = SCR_WIDTH / 2;           // Place mouse initially in center of screen
@@ -53,6 +67,22 @@ bool mouseFound = false; // If mouse has been moved
 const float FPS = 30.0f;
 const int GRID_WIDTH = 4;
 const int RENDER_RADIUS = 5;
+const uint64_t MARBLE_SEED = 1; // Seed of the marble texture noise
+const uint32_t MARBLE_VERSION = 1; // Bump whenever the marble generators change
+const int TEXTURE_TILE_ROWS = 16; // Rows of texture generated by each task
+
+/* Floor virtual texture settings */
+const int FLOOR_TABLE_SIZE = 64;            // Pages per side of the page table window, at every level
+const int FLOOR_LEVELS = 6;                 // Levels of detail of the floor
+const int FLOOR_CACHE_TILES = 16;           // Tiles per side of the tile cache
+const int FLOOR_TILE_SIZE = 128;            // Texels per side of a tile, border included
+const float FLOOR_TEXELS_PER_UNIT = 126.0f; // Level 0 texels per world unit, one page
+const int FEEDBACK_DIVISOR = 8;             // Feedback pass is this many times smaller than the window
+const double FLOOR_MARBLE_SPAN = 256;       // Texels over which the floor marble rises by Perlin::xPeriod
+
+/* Marble colors, in the blue, green, red order of the texture data */
+const int MARBLE_DARK[3] = {0, 0, 0};
+const int MARBLE_LIGHT[3] = {205, 224, 227};
 
 /* Main function */
 
@@ -92,7 +122,7 @@ int main()
     }
 
     /* Building and compiling shaders */
-    Shader mainShader("shaders/houseshader.vs", "shaders/houseshader.fs");
+    Shader mainShader(assets, "shaders/houseshader.vs", "shaders/houseshader.fs");
 
     /* Enable vertex depth */
     glEnable(GL_DEPTH_TEST);
@@ -136,9 +166,33 @@ int main()
     /* Configuring shader textures */
     mainShader.use();
 
-    /* Generate texture for ground */
+    /* Generate texture for the walls */
     bind_texture(512, 512, GL_TEXTURE0);
 
+    /* The floor never repeats: its pages are generated as they come into view */
+    Perlin floorNoise = Perlin(1, 1, MARBLE_SEED);
+    /* Owned through a pointer so its GL objects go before the context does */
+    std::unique_ptr<VirtualTexture> floorTexture(new VirtualTexture(
+        FLOOR_TABLE_SIZE, FLOOR_LEVELS, FLOOR_CACHE_TILES, FLOOR_TILE_SIZE,
+        SCR_WIDTH / FEEDBACK_DIVISOR, SCR_HEIGHT / FEEDBACK_DIVISOR,
+        [&floorNoise](double x, double y, double step, int size, unsigned char *bgr) {
+            generate_floor_tile(floorNoise, x, y, step, size, bgr);
+        }));
+    Shader floorShader(assets, "shaders/houseshader.vs", "shaders/virtualfloor.fs");
+    Shader feedbackShader(assets, "shaders/houseshader.vs", "shaders/virtualfeedback.fs");
+
+    floorShader.use();
+    floorTexture->Bind(floorShader.ID, GL_TEXTURE1, GL_TEXTURE2);
+    floorShader.setFloat("texelsPerUnit", FLOOR_TEXELS_PER_UNIT);
+    floorShader.setFloat("lodBias", 0.0f);
+    floorShader.setVec3("fallbackColor", (MARBLE_DARK[2] + MARBLE_LIGHT[2]) / 510.0f,
+                        (MARBLE_DARK[1] + MARBLE_LIGHT[1]) / 510.0f, (MARBLE_DARK[0] + MARBLE_LIGHT[0]) / 510.0f);
+
+    feedbackShader.use();
+    floorTexture->Bind(feedbackShader.ID, GL_TEXTURE1, GL_TEXTURE2);
+    feedbackShader.setFloat("texelsPerUnit", FLOOR_TEXELS_PER_UNIT);
+    feedbackShader.setFloat("lodBias", -log2((float)FEEDBACK_DIVISOR));
+
     /* Timing of frames */
     float delta = 0.0f;
     float prevFrame = static_cast<float>(glfwGetTime());
@@ -165,9 +219,6 @@ int main()
             glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            /* Use main shader */
-            mainShader.use();
-
             /* Always center ground right below camera */
             float cameraGridX, cameraGridZ; // World is split into grid_size x grid_size squares
             glm::vec3 cameraPos = camera.GetPosition();
@@ -214,6 +265,9 @@ int main()
                 }
             }
 
+            /* Stream in the floor pages seen over the last frames */
+            floorTexture->Update(cameraPos.x * FLOOR_TEXELS_PER_UNIT, cameraPos.z * FLOOR_TEXELS_PER_UNIT);
+
             /* Update camera height */
             camera.SetCameraHeight(-(float) (abs((int) cameraGridX) + abs((int) cameraGridZ)) / 3);
 
@@ -224,15 +278,6 @@ int main()
             projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
 
-            /* Store transformation data locations */
-            unsigned int modelLoc = glGetUniformLocation(mainShader.ID, "model");
-            unsigned int viewLoc = glGetUniformLocation(mainShader.ID, "view");
-            unsigned int projLoc = glGetUniformLocation(mainShader.ID, "projection");
-
-            /* View and projection values are constant */
-            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-            glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
             /* Map into buffer */
             glBindBuffer(GL_ARRAY_BUFFER, instanceVBO[0]);
             void *ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
@@ -254,7 +299,15 @@ int main()
             model = glm::scale(model, glm::vec3(GRID_WIDTH, 1.0, GRID_WIDTH));
             model = glm::translate(model, glm::vec3(cameraGridX, 0, cameraGridZ));
 
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            /* Every pass draws with the same transformations */
+            Shader *shaders[3] = {&feedbackShader, &floorShader, &mainShader};
+            for (Shader *shader : shaders)
+            {
+                shader->use();
+                shader->setMat4("model", model);
+                shader->setMat4("view", view);
+                shader->setMat4("projection", projection);
+            }
 
             cameraGridX = 0;
             cameraGridZ = 0;
@@ -262,12 +315,19 @@ int main()
             /* Bind VAO used for the ground*/
             glBindVertexArray(VAO[0]);
 
-            /* Set active texture for ground */
-            glUniform1i(glGetUniformLocation(mainShader.ID, "textureID"), 0);
+            /* Report the floor pages in view */
+            feedbackShader.use();
+            floorTexture->Begin_Feedback();
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, RENDER_COUNT);
+            floorTexture->End_Feedback();
 
             /* Draw grounds */
+            floorShader.use();
             glDrawArraysInstanced(GL_TRIANGLES, 0, 6, RENDER_COUNT);
 
+            /* Use main shader for the walls */
+            mainShader.use();
+
             /* Bind VAO used for the ground*/
             glBindVertexArray(VAO[1]);
 
@@ -293,6 +353,7 @@ int main()
     }
 
     /* Deallocate resources */
+    floorTexture.reset();
     glDeleteVertexArrays(3, VAO);
     glDeleteBuffers(3, VBO);
     glDeleteBuffers(3, instanceVBO);
@@ -411,7 +472,11 @@ void mouse_callback(GLFWwindow *window, double mouseX, double mouseY)
  *      corresponding to a gl texture.
  *
  *  Effects:
- *      Reads the bmp file binds it to the given gl texture.
+ *      Generates the marble texture and binds it to the given gl texture. The
+ *      texture is baked on the GPU, falling back to generate_texture if that
+ *      is not possible. Every mip level is generated directly from the noise
+ *      with the octaves it cannot show left out, and uploaded explicitly.
+ *      The finished chain is cached, so later launches map it instead.
  */
 int bind_texture(int height, int width, int glTexture)
 {
@@ -425,89 +490,277 @@ int bind_texture(int height, int width, int glTexture)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    /* Load textures */
-    Image image = generate_texture(height, width);
-    unsigned char *data = image.data;
+    /*
+     * Everything the marble depends on, naming it in the cache. The GPU bake
+     * and the CPU fallback agree to within one step per channel, so either
+     * one's chain serves both and the path taken is not part of the key.
+     */
+    Perlin perlin = Perlin((height + 1) / 2, (width + 1) / 2, MARBLE_SEED);
+    int levels = texture_levels(height, width);
+    TextureKey key;
+    key.Add("marble").Add(MARBLE_VERSION).Add(MARBLE_SEED).Add(width).Add(height).Add(levels)
+       .Add(perlin.xPeriod).Add(perlin.yPeriod).Add(perlin.power).Add(perlin.size)
+       .Add(MARBLE_DARK).Add(MARBLE_LIGHT);
+
+    std::unique_ptr<CachedTexture> cached = textureCache.Find("marble", key.Hash);
+    if (cached)
+    {
+        std::cout << "Mapped cached texture with width " << width << " and height " << height << std::endl;
+        cached->Upload();
+        return 0;
+    }
+
+    /* Allocate every level and try rendering into them */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = width >> level > 0 ? width >> level : 1;
+        int levelHeight = height >> level > 0 ? height >> level : 1;
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB8, levelWidth, levelHeight, 0, GL_BGR,
+                     GL_UNSIGNED_BYTE, NULL);
+    }
+    int baked = bake_texture_gpu(perlin, height, width, levels);
+    glBindTexture(GL_TEXTURE_2D, texture_ground);
+
+    if (baked == 0)
+    {
+        std::cout << "Baked texture with width " << width << " and height " << height << std::endl;
+#ifdef MARBLE_CHECK
+        ThreadPool pool;
+        std::cout << check_texture_gpu(perlin, pool, height, width)
+                  << " bytes differ from the CPU texture by more than one" << std::endl;
+#endif
+        textureCache.Store_Bound("marble", key.Hash, width, height, levels);
+        return 0;
+    }
 
     std::cout << "Reading texture with width " << width << " and height " << height << std::endl;
 
-    /* If succesfully loaded */
-    if (data)
+    /* Rows are tightly packed, whatever the width */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    ThreadPool pool;
+    for (int level = 0; level < levels; level++)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        /* Load textures */
+        Image image = level == 0 ? generate_texture(perlin, pool, height, width)
+                                 : generate_texture_level(perlin, pool, height, width, level);
+        unsigned char *data = image.data;
+
+        /* If succesfully loaded */
+        if (!data)
+        {
+            std::cout << "Error when loading texture data" << std::endl;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            return -1;
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, image.width, image.height, GL_BGR,
+                        GL_UNSIGNED_BYTE, data);
+        free(data);
     }
-    else
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    textureCache.Store_Bound("marble", key.Hash, width, height, levels);
+    return 0;
+}
+
+/*
+ *  Requires:
+ *      The width and height should be positive values.
+ *
+ *  Effects:
+ *      Returns the number of mip levels of a full chain down to 1x1.
+ */
+int texture_levels(int height, int width)
+{
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+/*
+ *  Requires:
+ *      The width and height should be positive values, and the texture bound
+ *      to GL_TEXTURE_2D on the active unit should have that size and the
+ *      given number of mip levels allocated.
+ *
+ *  Effects:
+ *      Renders the same marble of perlin as generate_texture into level 0 of
+ *      the bound texture and the same as generate_texture_level into the
+ *      others, one offscreen pass per level. Returns 0 on success and -1 if the shader
+ *      or framebuffer is unavailable, in which case nothing is drawn. The
+ *      texture binding of the active unit is changed.
+ */
+int bake_texture_gpu(const Perlin &perlin, int height, int width, int levels)
+{
+    unsigned int target;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, (int *)&target);
+
+    /* Compile the marble generator */
+    Shader marbleShader(assets, "shaders/marbleshader.vs", "shaders/marbleshader.fs");
+    int linked;
+    glGetProgramiv(marbleShader.ID, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        glDeleteProgram(marbleShader.ID);
+        return -1;
+    }
+
+    /* Attach the texture to an offscreen framebuffer */
+    unsigned int framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
-        std::cout << "Error when loading texture data" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteProgram(marbleShader.ID);
         return -1;
     }
-    delete[] data;
+
+    /* Upload the noise grid, sampled texel by texel */
+    float *grid = new float[perlin.Height * perlin.Width];
+    for (int i = 0; i < perlin.Height * perlin.Width; i++)
+        grid[i] = (float)perlin.NoiseGrid[i];
+
+    unsigned int noiseTexture;
+    glGenTextures(1, &noiseTexture);
+    glBindTexture(GL_TEXTURE_2D, noiseTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, perlin.Width, perlin.Height, 0, GL_RED, GL_FLOAT, grid);
+    delete[] grid;
+
+    /* Settings of the generator */
+    int unit;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+    marbleShader.use();
+    glUniform1i(glGetUniformLocation(marbleShader.ID, "noiseGrid"), unit - GL_TEXTURE0);
+    glUniform2i(glGetUniformLocation(marbleShader.ID, "bakeSize"), width, height);
+    glUniform1f(glGetUniformLocation(marbleShader.ID, "xPeriod"), perlin.xPeriod);
+    glUniform1f(glGetUniformLocation(marbleShader.ID, "yPeriod"), perlin.yPeriod);
+    glUniform1f(glGetUniformLocation(marbleShader.ID, "power"), perlin.power);
+    glUniform1f(glGetUniformLocation(marbleShader.ID, "size"), perlin.size);
+    glUniform3f(glGetUniformLocation(marbleShader.ID, "marbleDark"),
+                MARBLE_DARK[2], MARBLE_DARK[1], MARBLE_DARK[0]);
+    glUniform3f(glGetUniformLocation(marbleShader.ID, "marbleLight"),
+                MARBLE_LIGHT[2], MARBLE_LIGHT[1], MARBLE_LIGHT[0]);
+
+    /* Draw a single triangle covering each level */
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    unsigned int emptyVAO;
+    glGenVertexArrays(1, &emptyVAO);
+    glBindVertexArray(emptyVAO);
+    bool depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = width >> level > 0 ? width >> level : 1;
+        int levelHeight = height >> level > 0 ? height >> level : 1;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, level);
+        glUniform1f(glGetUniformLocation(marbleShader.ID, "footprint"), (float)(1 << level));
+        glViewport(0, 0, levelWidth, levelHeight);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+
+    /* Restore state */
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &noiseTexture);
+    glDeleteProgram(marbleShader.ID);
     return 0;
 }
 
 /*
  *  Requires:
- *      The width and height should be positive values.
+ *      The texture bound to GL_TEXTURE_2D on the active unit holds level 0 of
+ *      a marble baked by bake_texture_gpu with the given width and height.
  *
  *  Effects:
- *      Generates a random texture with the given width and height
+ *      Reads level 0 back and compares it with generate_texture, returning
+ *      how many bytes differ by more than one. The bake works in single
+ *      precision where the CPU uses doubles, so a value right at a byte
+ *      boundary may truncate one step apart; anything more is a bug. Built
+ *      into bind_texture with -DMARBLE_CHECK.
+ */
+int check_texture_gpu(const Perlin &perlin, ThreadPool &pool, int height, int width)
+{
+    unsigned char *baked = (unsigned char *)malloc(3 * width * height);
+    int alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_BGR, GL_UNSIGNED_BYTE, baked);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+    Image image = generate_texture(perlin, pool, height, width);
+    int mismatches = 0;
+    int offByOne = 0;
+    for (int i = 0; i < 3 * width * height; i++)
+    {
+        int difference = abs(baked[i] - image.data[i]);
+        mismatches += difference > 1;
+        offByOne += difference == 1;
+    }
+    std::cout << offByOne << " bytes of the baked texture are one step from the CPU texture" << std::endl;
+
+    free(image.data);
+    free(baked);
+    return mismatches;
+}
+
+/*
+ *  Requires:
+ *      The width and height should be positive values, and perlin a grid of
+ *      (height + 1) / 2 by (width + 1) / 2.
+ *
+ *  Effects:
+ *      Generates a random texture with the given width and height from
+ *      perlin on the workers of pool
  * */
-Image generate_texture(int height, int width)
+Image generate_texture(const Perlin &perlin, ThreadPool &pool, int height, int width)
 {
     /* Create corresponding image size*/
     unsigned char *data = (unsigned char *)calloc(3 * width * height, sizeof(unsigned char));
 
-    /* Create perlin noise */
-    Perlin perlin = Perlin((height + 1) / 2, (width + 1) / 2);
-
-    /* Marble Colors*/
-    int marble_dark[3] = {0, 0, 0};
-    int marble_light[3] = {205, 224, 227};
+    /* Generate the quadrant in tiles of rows, each mirrored once it is done */
+    pool.Parallel_For(0, height / 2, TEXTURE_TILE_ROWS, [&](int start, int end) {
+        /* Calculate noise for the whole tile at once */
+        double *tileNoise = new double[(width / 2) * (end - start)];
+        perlin.Perlin_Marble_Region(0, start, width / 2, end - start, tileNoise);
 
-    /* Generate internals */
-    for (int row = 0; row < height / 2; row++)
-    {
-        for (int col = 0; col < width / 2; col++)
+        for (int row = start; row < end; row++)
         {
-            /* Calculate noise */
-            double noise = perlin.Perlin_Marble(col, row);
+            unsigned char *line = data + 3 * row * width;
+            const double *rowNoise = tileNoise + (row - start) * (width / 2);
+
+            for (int col = 0; col < width / 2; col++)
+            {
+                /* Expand dark and light values */
+                double light_noise = rowNoise[col],
+                       dark_noise = 1 - rowNoise[col];
+
+                /* Blue, green and red */
+                for (int c = 0; c < 3; c++)
+                    line[3 * col + c] =
+                        (unsigned char)(dark_noise * MARBLE_DARK[c] + light_noise * MARBLE_LIGHT[c]);
+            }
 
-            /* Expand dark and light values */
-            double light_noise = noise,
-                   dark_noise = 1 - noise;
-
-            /* Blue */
-            data[3 * (row * width + col)] =
-                (unsigned char)(dark_noise * marble_dark[0] + light_noise * marble_light[0]);
-            /* Green */
-            data[3 * (row * width + col) + 1] =
-                (unsigned char)(dark_noise * marble_dark[1] + light_noise * marble_light[1]);
-            /* Red */
-            data[3 * (row * width + col) + 2] =
-                (unsigned char)(dark_noise * marble_dark[2] + light_noise * marble_light[2]);
-
-            /* Flip to corners TODO: SIMPLIFY THIS */
-            data[3 * ((height - 1 - row) * width + col)] =
-                data[3 * (row * width + col)];
-            data[3 * (row * width + (width - 1 - col))] =
-                data[3 * (row * width + col)];
-            data[3 * ((height - 1 - row) * width + (width - 1 - col))] =
-                data[3 * (row * width + col)];
-            data[3 * ((height - 1 - row) * width + col) + 1] =
-                data[3 * (row * width + col) + 1];
-            data[3 * (row * width + (width - 1 - col)) + 1] =
-                data[3 * (row * width + col) + 1];
-            data[3 * ((height - 1 - row) * width + (width - 1 - col)) + 1] =
-                data[3 * (row * width + col) + 1];
-            data[3 * ((height - 1 - row) * width + col) + 2] =
-                data[3 * (row * width + col) + 2];
-            data[3 * (row * width + (width - 1 - col)) + 2] =
-                data[3 * (row * width + col) + 2];
-            data[3 * ((height - 1 - row) * width + (width - 1 - col)) + 2] =
-                data[3 * (row * width + col) + 2];
+            /* Mirror the left half of the row into the right half */
+            for (int col = 0; col < width / 2; col++)
+                memcpy(line + 3 * (width - 1 - col), line + 3 * col, 3);
+
+            /* Mirror the row into the bottom half */
+            memcpy(data + 3 * (height - 1 - row) * width, line, 3 * width);
         }
-    }
+
+        delete[] tileNoise;
+    });
 
     /* Return Image data */
     Image image;
@@ -518,6 +771,114 @@ Image generate_texture(int height, int width)
     return image;
 }
 
+/*
+ *  Requires:
+ *      The width and height should be positive values, level at least 1 and
+ *      perlin the grid given to generate_texture.
+ *
+ *  Effects:
+ *      Generates mip level level of the texture of generate_texture directly.
+ *      Each pixel samples the marble at the center of the 2^level pixels it
+ *      covers, leaving out the turbulence octaves finer than that. Rows are
+ *      finished a batch at a time on the workers of pool.
+ */
+Image generate_texture_level(const Perlin &perlin, ThreadPool &pool, int height, int width, int level)
+{
+    int levelWidth = width >> level > 0 ? width >> level : 1;
+    int levelHeight = height >> level > 0 ? height >> level : 1;
+    double footprint = 1 << level;
+
+    /* Create corresponding image size*/
+    unsigned char *data = (unsigned char *)calloc(3 * levelWidth * levelHeight, sizeof(unsigned char));
+
+    pool.Parallel_For(0, levelHeight, TEXTURE_TILE_ROWS, [&](int start, int end) {
+        double *xs = new double[levelWidth];
+        double *ys = new double[levelWidth];
+        double *rowNoise = new double[levelWidth];
+
+        /* Centers of the covered columns, folded into the generated quadrant */
+        for (int col = 0; col < levelWidth; col++)
+        {
+            double x = (col + 0.5) * footprint - 0.5;
+            xs[col] = x < width - 1 - x ? x : width - 1 - x;
+        }
+
+        for (int row = start; row < end; row++)
+        {
+            /* Center of the covered rows, folded the same way */
+            double y = (row + 0.5) * footprint - 0.5;
+            y = y < height - 1 - y ? y : height - 1 - y;
+            for (int col = 0; col < levelWidth; col++)
+                ys[col] = y;
+            perlin.Perlin_Marble_LOD_Batch(xs, ys, footprint, rowNoise, levelWidth);
+
+            for (int col = 0; col < levelWidth; col++)
+            {
+                /* Expand dark and light values */
+                double light_noise = rowNoise[col],
+                       dark_noise = 1 - light_noise;
+
+                /* Blue, green and red */
+                for (int c = 0; c < 3; c++)
+                    data[3 * (row * levelWidth + col) + c] =
+                        (unsigned char)(dark_noise * MARBLE_DARK[c] + light_noise * MARBLE_LIGHT[c]);
+            }
+        }
+
+        delete[] xs;
+        delete[] ys;
+        delete[] rowNoise;
+    });
+
+    /* Return Image data */
+    Image image;
+    image.width = levelWidth;
+    image.height = levelHeight;
+    image.data = data;
+
+    return image;
+}
+
+/*
+ *  Requires:
+ *      bgr holds size x size texels.
+ *
+ *  Effects:
+ *      Generates a tile of the floor marble for the floor virtual texture,
+ *      texel (col, row) at (x + col * step, y + row * step) and covering step
+ *      texels. Unlike generate_texture the marble never repeats, its
+ *      turbulence being the hashed noise of Perlin_Val, and stripes and
+ *      octaves too fine for step fade to their mean instead of aliasing.
+ */
+void generate_floor_tile(const Perlin &perlin, double x, double y, double step, int size, unsigned char *bgr)
+{
+    /* Stripes fade out once a texel covers half of one */
+    double slopeX = perlin.xPeriod / FLOOR_MARBLE_SPAN;
+    double slopeY = perlin.yPeriod / FLOOR_MARBLE_SPAN;
+    double stripe = Perlin::Octave_Weight(0.5 / sqrt(slopeX * slopeX + slopeY * slopeY), step);
+    double mean = 2 / 3.141592;
+
+    for (int row = 0; row < size; row++)
+    {
+        double sampleY = y + row * step;
+        for (int col = 0; col < size; col++)
+        {
+            double sampleX = x + col * step;
+            double val = sampleX * slopeX + sampleY * slopeY +
+                         perlin.power * perlin.Perlin_Val_LOD(sampleX, sampleY, step) / 2;
+
+            /* Expand dark and light values */
+            double light_noise = mean + stripe * (fabs(sin(val * 3.141592)) - mean),
+                   dark_noise = 1 - light_noise;
+
+            /* Blue, green and red */
+            for (int c = 0; c < 3; c++)
+                bgr[3 * (row * size + col) + c] =
+                    (unsigned char)(dark_noise * MARBLE_DARK[c] + light_noise * MARBLE_LIGHT[c]);
+        }
+    }
+}
+
 /*
  * Requires:
  *      VAOs, VBOs, and instanceVBOs must be properly initialized arrays
@@ -0,0 +1,88 @@
+/* Header file for mapping whole files read only into memory */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Read only mapping of a whole file, with mmap or CreateFileMapping. Pages
+ * are read on first touch, so opening is cheap and the contents can be
+ * handed to GL or copied without a read buffer in between.
+ */
+class MappedFile
+{
+public:
+    const unsigned char *Data = NULL;   /* Start of the file, NULL if it cannot be mapped */
+    size_t Size = 0;                    /* Bytes in the file */
+
+    /*
+     * Effects:
+     *      Maps filename. Data is NULL if the file is missing, empty or
+     *      cannot be mapped.
+     */
+    explicit MappedFile(const char *filename)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            Data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            Size = Data ? (size_t)size.QuadPart : 0;
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        int file = open(filename, O_RDONLY);
+        if (file < 0)
+            return;
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (view != MAP_FAILED)
+            {
+                Data = (const unsigned char *)view;
+                Size = (size_t)info.st_size;
+            }
+        }
+        close(file);
+#endif
+    }
+
+    /* Unmaps the file */
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (Data)
+            UnmapViewOfFile(Data);
+#else
+        if (Data)
+            munmap((void *)Data, Size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+#endif
@@ -0,0 +1,316 @@
+/* Header file for composing noise functions at compile time */
+
+#ifndef NOISE_EXPR_H
+#define NOISE_EXPR_H
+
+#include <cmath>
+#include <utility>
+
+#include "basic_perlin.h"
+#include "perlin.h"
+
+/*
+ * Noise composition as expression templates.
+ *
+ * Every node is a small value type with a Value(x, y) method that holds its
+ * inputs by value, so a composed generator such as
+ *
+ *     remap(ramp(a, b) + power * fbm<5>(grid_noise(perlin), 1.0 / 16),
+ *           [](double v) { return fabs(sin(v * 3.141592)); })
+ *
+ * is a single type whose Value inlines into one fused loop body, with the
+ * octave loops unrolled and no virtual calls. Sources return values around
+ * [0, 1] like the rest of Perlin, and every combinator keeps that range
+ * unless it says otherwise.
+ */
+template <typename Derived>
+struct NoiseExpr
+{
+    const Derived &Self() const
+    {
+        return static_cast<const Derived &>(*this);
+    }
+};
+
+/* Source: bilinear noise of a Perlin grid, as Perlin::SmoothNoise */
+struct GridNoise : NoiseExpr<GridNoise>
+{
+    typedef double Real;
+    const Perlin *Grid;
+
+    explicit GridNoise(const Perlin &grid) : Grid(&grid) {}
+
+    double Value(double x, double y) const
+    {
+        return Grid->SmoothNoise(x, y);
+    }
+};
+
+/* Source: a single octave of gradient noise, as BasicPerlin::Calc_Perlin<I> */
+template <typename RealType, int I = 0, typename HashPolicy = PerlinPrimeHash>
+struct GradientNoise : NoiseExpr<GradientNoise<RealType, I, HashPolicy>>
+{
+    typedef RealType Real;
+    BasicPerlin<Real, I + 1, HashPolicy> Noise;
+
+    Real Value(Real x, Real y) const
+    {
+        return Noise.template Calc_Perlin<I>(x, y);
+    }
+};
+
+/* Source: the linear function XSlope * x + YSlope * y */
+template <typename RealType>
+struct Ramp : NoiseExpr<Ramp<RealType>>
+{
+    typedef RealType Real;
+    Real XSlope, YSlope;
+
+    Ramp(Real xSlope, Real ySlope) : XSlope(xSlope), YSlope(ySlope) {}
+
+    Real Value(Real x, Real y) const
+    {
+        return x * XSlope + y * YSlope;
+    }
+};
+
+/*
+ * Fractal sum of Octaves copies of Source. Octave k is sampled at
+ * Frequency * Lacunarity^k and weighted by Amplitude * Gain^k.
+ */
+template <int Octaves, typename Source>
+struct Fbm : NoiseExpr<Fbm<Octaves, Source>>
+{
+    static_assert(Octaves >= 1, "Fbm needs at least one octave");
+
+    typedef typename Source::Real Real;
+    Source Src;
+    Real Frequency, Lacunarity, Gain, Amplitude;
+
+    Fbm(const Source &src, Real frequency, Real lacunarity, Real gain, Real amplitude)
+        : Src(src), Frequency(frequency), Lacunarity(lacunarity), Gain(gain), Amplitude(amplitude) {}
+
+    Real Value(Real x, Real y) const
+    {
+        return Sum_Octaves(x, y, std::make_integer_sequence<int, Octaves>());
+    }
+
+private:
+    /* Adds the octaves in order, expanded at compile time */
+    template <int... Is>
+    Real Sum_Octaves(Real x, Real y, std::integer_sequence<int, Is...>) const
+    {
+        Real total = 0;
+        Real frequency = Frequency;
+        Real amplitude = Amplitude;
+        ((total += Src.Value(x * frequency, y * frequency) * amplitude,
+          frequency *= Lacunarity, amplitude *= Gain, (void)Is), ...);
+        return total;
+    }
+};
+
+/* Folds Source about 0.5 into ridges: 1 where it is 0.5, 0 where it is 0 or 1 */
+template <typename Source>
+struct Ridged : NoiseExpr<Ridged<Source>>
+{
+    typedef typename Source::Real Real;
+    Source Src;
+
+    explicit Ridged(const Source &src) : Src(src) {}
+
+    Real Value(Real x, Real y) const
+    {
+        using std::abs;
+        return 1 - abs(2 * Src.Value(x, y) - 1);
+    }
+};
+
+/*
+ * Samples Source at a location displaced by OffsetX and OffsetY. Offsets are
+ * centered so a value of 0.5 leaves the location unchanged, and Strength is
+ * the displacement at 0 or 1.
+ */
+template <typename Source, typename OffsetXExpr, typename OffsetYExpr>
+struct Warp : NoiseExpr<Warp<Source, OffsetXExpr, OffsetYExpr>>
+{
+    typedef typename Source::Real Real;
+    Source Src;
+    OffsetXExpr OffsetX;
+    OffsetYExpr OffsetY;
+    Real Strength;
+
+    Warp(const Source &src, const OffsetXExpr &offsetX, const OffsetYExpr &offsetY, Real strength)
+        : Src(src), OffsetX(offsetX), OffsetY(offsetY), Strength(strength) {}
+
+    Real Value(Real x, Real y) const
+    {
+        Real dx = (OffsetX.Value(x, y) - Real(0.5)) * 2 * Strength;
+        Real dy = (OffsetY.Value(x, y) - Real(0.5)) * 2 * Strength;
+        return Src.Value(x + dx, y + dy);
+    }
+};
+
+/* Passes every value of Source through the function Map */
+template <typename Source, typename Function>
+struct Remap : NoiseExpr<Remap<Source, Function>>
+{
+    typedef typename Source::Real Real;
+    Source Src;
+    Function Map;
+
+    Remap(const Source &src, const Function &map) : Src(src), Map(map) {}
+
+    Real Value(Real x, Real y) const
+    {
+        return Map(Src.Value(x, y));
+    }
+};
+
+/* Sum of two expressions */
+template <typename Left, typename Right>
+struct Sum : NoiseExpr<Sum<Left, Right>>
+{
+    typedef typename Left::Real Real;
+    Left A;
+    Right B;
+
+    Sum(const Left &a, const Right &b) : A(a), B(b) {}
+
+    Real Value(Real x, Real y) const
+    {
+        return A.Value(x, y) + B.Value(x, y);
+    }
+};
+
+/* Source times Factor plus Offset */
+template <typename Source>
+struct Scale : NoiseExpr<Scale<Source>>
+{
+    typedef typename Source::Real Real;
+    Source Src;
+    Real Factor, Offset;
+
+    Scale(const Source &src, Real factor, Real offset) : Src(src), Factor(factor), Offset(offset) {}
+
+    Real Value(Real x, Real y) const
+    {
+        return Src.Value(x, y) * Factor + Offset;
+    }
+};
+
+/* Builders, deducing the node types from their arguments */
+
+inline GridNoise grid_noise(const Perlin &perlin)
+{
+    return GridNoise(perlin);
+}
+
+template <typename Real, int I = 0, typename HashPolicy = PerlinPrimeHash>
+GradientNoise<Real, I, HashPolicy> gradient_noise(int gradientMode = PERLIN_GRADIENT_ANGLE)
+{
+    GradientNoise<Real, I, HashPolicy> source;
+    source.Noise.GradientMode = gradientMode;
+    return source;
+}
+
+inline Ramp<double> ramp(double xSlope, double ySlope)
+{
+    return Ramp<double>(xSlope, ySlope);
+}
+
+/*
+ * Defaults halve the weight of every finer octave and keep the sum of the
+ * weights just under 1, as Perlin::Turbulence does.
+ */
+template <int Octaves, typename Source>
+Fbm<Octaves, Source> fbm(const NoiseExpr<Source> &src, typename Source::Real frequency,
+                         typename Source::Real lacunarity = 2, typename Source::Real gain = 0.5,
+                         typename Source::Real amplitude = 0.5)
+{
+    return Fbm<Octaves, Source>(src.Self(), frequency, lacunarity, gain, amplitude);
+}
+
+template <typename Source>
+Ridged<Source> ridged(const NoiseExpr<Source> &src)
+{
+    return Ridged<Source>(src.Self());
+}
+
+template <typename Source, typename OffsetXExpr, typename OffsetYExpr>
+Warp<Source, OffsetXExpr, OffsetYExpr> warp(const NoiseExpr<Source> &src,
+                                            const NoiseExpr<OffsetXExpr> &offsetX,
+                                            const NoiseExpr<OffsetYExpr> &offsetY,
+                                            typename Source::Real strength)
+{
+    return Warp<Source, OffsetXExpr, OffsetYExpr>(src.Self(), offsetX.Self(), offsetY.Self(), strength);
+}
+
+template <typename Source, typename Function>
+Remap<Source, Function> remap(const NoiseExpr<Source> &src, const Function &map)
+{
+    return Remap<Source, Function>(src.Self(), map);
+}
+
+template <typename Left, typename Right>
+Sum<Left, Right> operator+(const NoiseExpr<Left> &a, const NoiseExpr<Right> &b)
+{
+    return Sum<Left, Right>(a.Self(), b.Self());
+}
+
+template <typename Source>
+Scale<Source> operator*(typename Source::Real factor, const NoiseExpr<Source> &src)
+{
+    return Scale<Source>(src.Self(), factor, 0);
+}
+
+template <typename Source>
+Scale<Source> operator*(const NoiseExpr<Source> &src, typename Source::Real factor)
+{
+    return Scale<Source>(src.Self(), factor, 0);
+}
+
+template <typename Source>
+Scale<Source> operator+(const NoiseExpr<Source> &src, typename Source::Real offset)
+{
+    return Scale<Source>(src.Self(), 1, offset);
+}
+
+/*
+ * Requires:
+ *      perlin.size is 2^(Octaves - 1), 16 for the default of 5.
+ *
+ * Effects:
+ *      Returns Perlin::Perlin_Marble of perlin as a composed expression,
+ *      matching it to within 1e-12.
+ */
+template <int Octaves = 5>
+auto perlin_marble(const Perlin &perlin)
+{
+    return remap(ramp(perlin.xPeriod / perlin.Width, perlin.yPeriod / perlin.Height) +
+                     perlin.power * fbm<Octaves>(grid_noise(perlin), 1 / perlin.size),
+                 [](double val) { return std::abs(std::sin(val * 3.141592)); });
+}
+
+/*
+ * Requires:
+ *      out holds width * height values.
+ *
+ * Effects:
+ *      Writes the value of expr at (x0 + col * step, y0 + row * step) to
+ *      out[row * width + col] for every row and col.
+ */
+template <typename Expr>
+void noise_fill(const NoiseExpr<Expr> &expr, typename Expr::Real x0, typename Expr::Real y0,
+                typename Expr::Real step, int width, int height, typename Expr::Real *out)
+{
+    typedef typename Expr::Real Real;
+    const Expr &e = expr.Self();
+    for (int row = 0; row < height; row++)
+    {
+        Real y = y0 + row * step;
+        for (int col = 0; col < width; col++)
+            out[(size_t)row * width + col] = e.Value(x0 + col * step, y);
+    }
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Asset packer
+ *
+ * Packs every file below the given directories into one archive that
+ * AssetArchive maps at startup. Each file is stored under the name of its
+ * directory followed by its path inside it, so packing "shaders" and
+ * "../textures" gives "shaders/fogshader.vs" and
+ * "textures/ground_texture.dds", the paths the demos already use.
+ *
+ * Usage: pack_assets <output.pak> <directory>...
+ */
+
+/* Library imports */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* Header files */
+#include "asset_archive.h"
+
+namespace fs = std::filesystem;
+
+/* File to pack and the name it is found under */
+struct Input
+{
+    std::string name;
+    fs::path path;
+};
+
+static void put_u32(std::vector<unsigned char> &out, size_t at, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[at + i] = (unsigned char)(value >> (8 * i));
+}
+
+/* Pads out with zeros up to a multiple of the archive alignment */
+static void align(std::vector<unsigned char> &out)
+{
+    while (out.size() % AssetArchive::ALIGNMENT)
+        out.push_back(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "Usage: %s <output.pak> <directory>...\n", argv[0]);
+        return 2;
+    }
+
+    /* Every regular file below the directories, named after the directory */
+    std::vector<Input> inputs;
+    for (int i = 2; i < argc; i++)
+    {
+        std::error_code error;
+        fs::path root = fs::path(argv[i]).lexically_normal();
+        std::string prefix = (root.has_filename() ? root.filename() : root.parent_path().filename()).generic_string();
+        for (fs::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->is_regular_file())
+                inputs.push_back({prefix + "/" + it->path().lexically_relative(root).generic_string(), it->path()});
+        }
+        if (error)
+        {
+            std::fprintf(stderr, "%s: %s\n", argv[i], error.message().c_str());
+            return 1;
+        }
+    }
+
+    /* Find relies on the names being sorted and unique */
+    std::sort(inputs.begin(), inputs.end(), [](const Input &a, const Input &b) { return a.name < b.name; });
+    for (size_t i = 1; i < inputs.size(); i++)
+    {
+        if (inputs[i].name == inputs[i - 1].name)
+        {
+            std::fprintf(stderr, "%s: packed twice\n", inputs[i].name.c_str());
+            return 1;
+        }
+    }
+
+    /* Header and index, filled in as the names and contents are laid out */
+    std::vector<unsigned char> out(AssetArchive::HEADER_SIZE + inputs.size() * AssetArchive::ENTRY_SIZE, 0);
+    std::memcpy(&out[0], "PRNA", 4);
+    put_u32(out, 4, AssetArchive::VERSION);
+    put_u32(out, 8, (uint32_t)inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        size_t entry = AssetArchive::HEADER_SIZE + i * AssetArchive::ENTRY_SIZE;
+        put_u32(out, entry, (uint32_t)out.size());
+        put_u32(out, entry + 4, (uint32_t)inputs[i].name.size());
+        out.insert(out.end(), inputs[i].name.begin(), inputs[i].name.end());
+        out.push_back(0);
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        size_t entry = AssetArchive::HEADER_SIZE + i * AssetArchive::ENTRY_SIZE;
+        MappedFile file(inputs[i].path.string().c_str());
+        if (!file.Data && fs::file_size(inputs[i].path) != 0)
+        {
+            std::fprintf(stderr, "%s: cannot open or map file\n", inputs[i].path.string().c_str());
+            return 1;
+        }
+
+        align(out);
+        put_u32(out, entry + 8, (uint32_t)out.size());
+        put_u32(out, entry + 12, (uint32_t)file.Size);
+        out.insert(out.end(), file.Data, file.Data + file.Size);
+        out.push_back(0);
+        if (out.size() > UINT32_MAX)
+        {
+            std::fprintf(stderr, "%s: archive larger than 4 GB\n", argv[1]);
+            return 1;
+        }
+        std::printf("%s: %zu bytes\n", inputs[i].name.c_str(), file.Size);
+    }
+
+    FILE *output = std::fopen(argv[1], "wb");
+    bool written = output && std::fwrite(out.data(), 1, out.size(), output) == out.size();
+    if (output && std::fclose(output) != 0)
+        written = false;
+    if (!written)
+    {
+        std::fprintf(stderr, "%s: cannot write archive\n", argv[1]);
+        return 1;
+    }
+    std::printf("Packed %zu assets into %zu bytes\n", inputs.size(), out.size());
+    return 0;
+}
@@ -1,10 +1,28 @@
+#ifndef PERLIN_H
+#define PERLIN_H
+
 
 #include <cstdio>
 #include <cmath>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "basic_perlin.h"
+#include "perlin_simd.h"
+#include "turbulence_pyramid.h"
 
 using namespace std;
 
+/* Noise engines Perlin_Val can sum */
+enum PerlinEngine
+{
+    PERLIN_ENGINE_GRADIENT = 0, /* Calc_Perlin, 4 corners per octave */
+    PERLIN_ENGINE_SIMPLEX = 1,  /* Calc_Simplex, 3 corners per octave */
+};
+
 /*
  * Perlin
  */
@@ -35,34 +53,143 @@ public:
     double size = 16;
     int Height;
     int Width;
-    double** NoiseGrid;
+    int HeightMask;                         /* Height - 1 for powers of two, otherwise -1 */
+    int WidthMask;                          /* Width - 1 for powers of two, otherwise -1 */
+    double* NoiseGrid;                      /* Height rows of Width values, cache line aligned */
+    int GradientMode = PERLIN_GRADIENT_ANGLE;
+    int Engine = PERLIN_ENGINE_GRADIENT;   /* Noise used by Perlin_Val for this layer */
+    int HashMode = PERLIN_HASH_PRIME;      /* Hash picking the value of every grid point */
+
+    uint64_t Seed = 0;                      /* Seed of the grid, 0 for grids from rand() */
+
+    /* Alignment of NoiseGrid in bytes */
+    static const size_t GRID_ALIGNMENT = 64;
 
     /*
-     * Constructor that creates the Perlin noise class.
+     * Constructor that creates the Perlin noise class from the global rand().
+     * Kept so existing worlds reproduce; not safe to call from several threads.
      */
     Perlin(int height, int width)
     {
         Height = height;
         Width = width;
+        Compute_Masks();
 
         /* Allocate array */
-        NoiseGrid = (double **) malloc(height * sizeof(double*));
+        NoiseGrid = Allocate_Grid(height, width);
+
+        /* Create initial noise */
         for (int i = 0; i < height; i++) {
-            NoiseGrid[i] = (double*) malloc(width * sizeof(double));
+            for (int j = 0; j < width; j++) {
+                NoiseGrid[i * width + j] = (rand() % 32768) / 32768.0;
+            }
         }
+    }
 
-        /* Create initial noise */
+    /*
+     * Constructor that creates the Perlin noise class from an explicit seed.
+     * The grid and hashes only depend on the seed and size, so instances with
+     * the same seed are identical no matter which thread builds them. Every
+     * seed but 0 also moves the hash constants (Seed_Primes), so only seed 0
+     * hashes like the two argument constructor.
+     */
+    Perlin(int height, int width, uint64_t seed)
+    {
+        Height = height;
+        Width = width;
+        Seed = seed;
+        Compute_Masks();
+
+        /* Allocate array */
+        NoiseGrid = Allocate_Grid(height, width);
+
+        /* Create initial noise, each value from its own counter */
         for (int i = 0; i < height; i++) {
             for (int j = 0; j < width; j++) {
-                NoiseGrid[i][j] = (rand() % 32768) / 32768.0;
+                uint64_t counter = (uint64_t)i * width + j;
+                NoiseGrid[i * width + j] = Seeded_Noise(seed, counter);
             }
         }
+
+        /* The hashed noises ignore the grid, so the seed keys their hashes too */
+        Seed_Primes(seed);
+    }
+
+    /*
+     * Effects:
+     *      Offsets the hash constants of every octave by an even amount drawn
+     *      from the seed, so Perlin_Val, the simplex and the 3D noises differ
+     *      between seeds like the grid does. They stay odd, and seed 0 keeps
+     *      the original constants.
+     */
+    void Seed_Primes(uint64_t seed)
+    {
+        if (seed == 0)
+            return;
+        for (int i = 0; i < 15; i++)
+            Primes[i] += 2 * (int)(Seeded_Noise(~seed, i) * (1 << 20));
+    }
+
+    /* True while Primes holds the constants BasicPerlin is built on */
+    bool Default_Primes() const
+    {
+        static_assert(sizeof(Primes) == sizeof(PerlinPrimeHash::Primes), "Prime tables differ in size");
+        return memcmp(Primes, PerlinPrimeHash::Primes, sizeof(Primes)) == 0;
+    }
+
+    /*
+     * Effects:
+     *      Counter-based generator, returns a value in [0, 1) that depends only
+     *      on the seed and the counter (SplitMix64 finalizer).
+     */
+    static double Seeded_Noise(uint64_t seed, uint64_t counter)
+    {
+        uint64_t z = seed + (counter + 1) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z = z ^ (z >> 31);
+        return (double)(z >> 11) / 9007199254740992.0;
+    }
+
+    /* Copy constructor, duplicates the noise grid */
+    Perlin(const Perlin &other)
+    {
+        Copy_Fields(other);
+        NoiseGrid = nullptr;
+
+        /* A moved-from Perlin has no grid, and its copy has none either */
+        if (other.NoiseGrid) {
+            NoiseGrid = Allocate_Grid(Height, Width);
+            memcpy(NoiseGrid, other.NoiseGrid, (size_t)Height * Width * sizeof(double));
+        }
+    }
+
+    /* Move constructor, takes over the noise grid */
+    Perlin(Perlin &&other) noexcept
+    {
+        Copy_Fields(other);
+        NoiseGrid = other.NoiseGrid;
+        other.NoiseGrid = nullptr;
+        other.Height = other.Width = 0;
+    }
+
+    /* Copy and move assignment */
+    Perlin &operator=(Perlin other) noexcept
+    {
+        Copy_Fields(other);
+        std::swap(NoiseGrid, other.NoiseGrid);
+        return *this;
+    }
+
+    ~Perlin()
+    {
+        Free_Grid(NoiseGrid);
     }
 
     /**
      * Returns the smoothed noise value at a specific pixel 
      */
-    double SmoothNoise(double x, double y)
+    double SmoothNoise(double x, double y) const
     {
         /* Fractional parts of x and y */
         double fX = x - (int) x;
@@ -71,22 +198,40 @@ public:
         /* Integer parts */
         int iX1 = (int) x;
         int iY1 = (int) y;
+        int iX2, iY2;
 
-        int iX2 = (iX1 - 1 + Width) % Width;
-        int iY2 = (iY1 - 1 + Height) % Height;
+        /* Wrap around the grid, with a mask where possible */
+        if (WidthMask >= 0) {
+            iX2 = (iX1 - 1) & WidthMask;
+            iX1 &= WidthMask;
+        }
+        else {
+            iX2 = (iX1 - 1 + Width) % Width;
+        }
+        if (HeightMask >= 0) {
+            iY2 = (iY1 - 1) & HeightMask;
+            iY1 &= HeightMask;
+        }
+        else {
+            iY2 = (iY1 - 1 + Height) % Height;
+        }
+
+        /* Rows of the grid */
+        const double *row1 = NoiseGrid + iY1 * Width;
+        const double *row2 = NoiseGrid + iY2 * Width;
 
         /* Calculate smoothed value */
         double total = 0;
-        total += fX * fY * NoiseGrid[iY1][iX1];
-        total += (1 - fX) * fY * NoiseGrid[iY1][iX2];
-        total += fX * (1 - fY) * NoiseGrid[iY2][iX1];
-        total += (1 - fX) * (1 - fY) * NoiseGrid[iY2][iX2];
+        total += fX * fY * row1[iX1];
+        total += (1 - fX) * fY * row1[iX2];
+        total += fX * (1 - fY) * row2[iX1];
+        total += (1 - fX) * (1 - fY) * row2[iX2];
 
         return total;
     }
 
     /* Calculates the turbulence noise based on a given size */
-    double Turbulence(double x, double y, double size)
+    double Turbulence(double x, double y, double size) const
     {
         double total = 0;
         double sizeWalker = size;
@@ -101,8 +246,53 @@ public:
         return (total / size / 2);
     }
 
+    /*
+     * Returns how much of an octave with the given period survives when one
+     * sample covers footprint units: 1 down to period == footprint, fading
+     * to 0 at half of it. For mip level L of a texture, footprint is 2^L.
+     */
+    static double Octave_Weight(double period, double footprint)
+    {
+        double weight = log2(period / footprint) + 1;
+        return weight > 1 ? 1 : (weight < 0 ? 0 : weight);
+    }
+
+    /*
+     * Calculates the turbulence noise for samples covering footprint units.
+     * Octaves too fine to be seen are replaced by their mean instead of being
+     * evaluated, and the last visible one is faded in. Same as Turbulence
+     * for a footprint of 1 or less.
+     */
+    double Turbulence_LOD(double x, double y, double size, double footprint) const
+    {
+        double total = 0;
+        double sizeWalker = size;
+
+        /* Calculate overlapping turbulence while octaves are visible */
+        while (sizeWalker >= 1)
+        {
+            double weight = Octave_Weight(sizeWalker, footprint);
+            if (weight <= 0)
+                break;
+            double noise = SmoothNoise(x / sizeWalker, y / sizeWalker);
+            if (weight < 1)
+                noise = weight * noise + (1 - weight) * 0.5;
+            total += noise * sizeWalker;
+            sizeWalker /= 2;
+        }
+
+        /* Remaining octaves average to the grid mean */
+        while (sizeWalker >= 1)
+        {
+            total += 0.5 * sizeWalker;
+            sizeWalker /= 2;
+        }
+
+        return (total / size / 2);
+    }
+
     /* Interpolates between two values */
-    double Interpolate(double a, double b, double w)
+    double Interpolate(double a, double b, double w) const
     {
         /* Clamping */
         w = w > 1 ? 1 : w;
@@ -113,51 +303,99 @@ public:
         return (b - a) * w + a;
     }
 
+    /*
+     * Generates the 30 bit hash of a grid point for the given octave
+     */
+    int Hash(int i, int x, int y) const
+    {
+        if (HashMode == PERLIN_HASH_MIX)
+            return (int)PerlinMixHash::Mix(Primes[i * 3], x, y, 0);
+        return Hash_Prime(i, (uint32_t)x + (uint32_t)y * 59u);
+    }
+
+    /*
+     * Generates the 30 bit hash of a 3D grid point for the given octave
+     */
+    int Hash3(int i, int x, int y, int z) const
+    {
+        if (HashMode == PERLIN_HASH_MIX)
+            return (int)PerlinMixHash::Mix(Primes[i * 3], x, y, z);
+        return Hash_Prime(i, (uint32_t)x + (uint32_t)y * 59u + (uint32_t)z * 3571u);
+    }
+
+    /* PerlinPrimeHash of a combined grid coordinate with the primes of octave i */
+    int Hash_Prime(int i, uint32_t n) const
+    {
+        return (int)PerlinPrimeHash::Mix(Primes[i * 3], Primes[i * 3 + 1], Primes[i * 3 + 2], n);
+    }
+
     /*
      * Generates pseudorandom noise value between 0 and 1
      */
-    double Noise(int i, int x, int y)
+    double Noise(int i, int x, int y) const
     {
-        int n = x + y * 59;
-        n = (n << 13) ^ n;
-        int a = Primes[i * 3], b = Primes[i * 3 + 1], c = Primes[i * 3 + 2];
-        int t = (n * (n * n * a + b) + c) & 0x3fffffff;
+        int t = Hash(i, x, y);
         double rand = 1.0 - (double)(t) / (1 << 30);
         return rand;
     }
     /*
      * Generates pseudorandom noise value between 0 and 2pi
      */
-    double Cos_Noise(int i, int x, int y)
+    double Cos_Noise(int i, int x, int y) const
     {
-        int n = x + y * 59;
-        n = (n << 13) ^ n;
-        int a = Primes[i * 3], b = Primes[i * 3 + 1], c = Primes[i * 3 + 2];
-        int t = (n * (n * n * a + b) + c) & 0x3fffffff;
+        int t = Hash(i, x, y);
         double rand = 2.0 - (double)(t) / (1 << 29);
         return rand * 3.14159265;
     }
 
     /*
-     * Calculates the dot product with the gradient
+     * Returns the shared table of unit gradients
      */
-    double Gradient(int i, int ix, int iy, double x, double y)
+    static const PerlinGradientTable &Gradient_Table()
     {
+        return PerlinGradientTable::Get();
+    }
+
+    /*
+     * Returns the unit gradient of a grid point in gx and gy
+     */
+    void Gradient_Vector(int i, int ix, int iy, double *gx, double *gy) const
+    {
+        /* Look up the gradient, indexed by the top bits of the hash */
+        if (GradientMode == PERLIN_GRADIENT_TABLE)
+        {
+            const PerlinGradientTable &table = Gradient_Table();
+            int k = Hash(i, ix, iy) >> 22;
+            *gx = table.X[k];
+            *gy = table.Y[k];
+            return;
+        }
+
         /* Calculate noise */
         double noise = Cos_Noise(i, ix, iy);
+        *gx = cos(noise);
+        *gy = sin(noise);
+    }
 
+    /*
+     * Calculates the dot product with the gradient
+     */
+    double Gradient(int i, int ix, int iy, double x, double y) const
+    {
         /* Calculate distances */
         double dx = x - (double)ix;
         double dy = y - (double)iy;
 
         /* Return dot product */
-        return (dx * cos(noise) + dy * sin(noise)) * 0.5 + 0.5;
+        double gx, gy;
+        Gradient_Vector(i, ix, iy, &gx, &gy);
+        return (dx * gx + dy * gy) * 0.5 + 0.5;
     }
 
     /*
      * Calculates perlin at a given location
      */
-    double Calc_Perlin(int i, double x, double y)
+    double Calc_Perlin(int i, double x, double y) const
     {
 
         /* Grid points */
@@ -178,22 +416,523 @@ public:
         return Interpolate(i1, i2, fy);
     }
 
-    double Perlin_Val(double x, double y)
+    /* Same as (int)floor(x) for every x in int range, without the libm call */
+    static int Fast_Floor(double x)
+    {
+        int i = (int)x;
+        return i - (x < (double)i);
+    }
+
+    /*
+     * Contribution of one corner of a simplex triangle
+     */
+    double Simplex_Corner(int i, int ix, int iy, double dx, double dy) const
+    {
+        double falloff = 0.5 - dx * dx - dy * dy;
+        if (falloff <= 0)
+            return 0;
+
+        double gx, gy;
+        Gradient_Vector(i, ix, iy, &gx, &gy);
+        falloff *= falloff;
+        return falloff * falloff * (dx * gx + dy * gy);
+    }
+
+    /*
+     * Contribution of one corner of a simplex tetrahedron. Gradients are the
+     * 12 edge midpoints of a cube, picked by the hash.
+     */
+    double Simplex_Corner(int i, int ix, int iy, int iz, double dx, double dy, double dz) const
+    {
+        double falloff = 0.6 - dx * dx - dy * dy - dz * dz;
+        if (falloff <= 0)
+            return 0;
+
+        falloff *= falloff;
+        return falloff * falloff * Gradient3(i, ix, iy, iz, dx, dy, dz);
+    }
+
+    /*
+     * Dot product of (dx, dy, dz) with the gradient of a 3D grid point, one
+     * of the 12 edge midpoints of a cube picked by the hash
+     */
+    double Gradient3(int i, int ix, int iy, int iz, double dx, double dy, double dz) const
+    {
+        static const signed char EDGES[12][3] = {
+            {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+            {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+            {0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1},
+        };
+
+        const signed char *g = EDGES[(Hash3(i, ix, iy, iz) >> 18) % 12];
+        return dx * g[0] + dy * g[1] + dz * g[2];
+    }
+
+    /*
+     * Calculates 3D gradient noise that repeats every period units along
+     * each axis, for volumes that have to tile. Grid points are wrapped
+     * before hashing and blended with a quintic fade. Same range as
+     * Calc_Perlin.
+     */
+    double Calc_Perlin3_Tiled(int i, double x, double y, double z, int period) const
+    {
+        /* Grid points */
+        int x0 = Fast_Floor(x);
+        int y0 = Fast_Floor(y);
+        int z0 = Fast_Floor(z);
+        double fx = x - x0, fy = y - y0, fz = z - z0;
+
+        /* Wrapped coordinates of both corners along every axis */
+        int wx[2] = {((x0 % period) + period) % period, 0};
+        int wy[2] = {((y0 % period) + period) % period, 0};
+        int wz[2] = {((z0 % period) + period) % period, 0};
+        wx[1] = wx[0] + 1 == period ? 0 : wx[0] + 1;
+        wy[1] = wy[0] + 1 == period ? 0 : wy[0] + 1;
+        wz[1] = wz[0] + 1 == period ? 0 : wz[0] + 1;
+
+        /* Quintic fade keeps the second derivative continuous across cells */
+        double u = fx * fx * fx * (fx * (fx * 6 - 15) + 10);
+        double v = fy * fy * fy * (fy * (fy * 6 - 15) + 10);
+        double w = fz * fz * fz * (fz * (fz * 6 - 15) + 10);
+
+        double corners[2][2];
+        for (int k = 0; k < 2; k++)
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                double a = Gradient3(i, wx[0], wy[j], wz[k], fx, fy - j, fz - k);
+                double b = Gradient3(i, wx[1], wy[j], wz[k], fx - 1, fy - j, fz - k);
+                corners[k][j] = a + (b - a) * u;
+            }
+        }
+        double front = corners[0][0] + (corners[0][1] - corners[0][0]) * v;
+        double back = corners[1][0] + (corners[1][1] - corners[1][0]) * v;
+
+        /* Edge gradients reach about 1 in magnitude, map to about [0, 1] */
+        return (front + (back - front) * w) * 0.5 + 0.5;
+    }
+
+    /*
+     * Calculates perlin at a given location, and its partial derivatives
+     * along x and y in ddx and ddy. The value matches Calc_Perlin.
+     */
+    double Calc_PerlinDeriv(int i, double x, double y, double *ddx, double *ddy) const
+    {
+        /* Grid points */
+        int x0 = (int)floor(x);
+        int x1 = x0 + 1;
+        int y0 = (int)floor(y);
+        int y1 = y0 + 1;
+
+        /* Interpolation values */
+        double fx = x - (double)x0;
+        double fy = y - (double)y0;
+
+        /* Corner gradients, each corner is linear in x and y */
+        double gx[4], gy[4];
+        Gradient_Vector(i, x0, y0, &gx[0], &gy[0]);
+        Gradient_Vector(i, x1, y0, &gx[1], &gy[1]);
+        Gradient_Vector(i, x0, y1, &gx[2], &gy[2]);
+        Gradient_Vector(i, x1, y1, &gx[3], &gy[3]);
+
+        double g00 = (fx * gx[0] + fy * gy[0]) * 0.5 + 0.5;
+        double g10 = ((x - (double)x1) * gx[1] + fy * gy[1]) * 0.5 + 0.5;
+        double g01 = (fx * gx[2] + (y - (double)y1) * gy[2]) * 0.5 + 0.5;
+        double g11 = ((x - (double)x1) * gx[3] + (y - (double)y1) * gy[3]) * 0.5 + 0.5;
+
+        /* Interpolate along x */
+        double i1 = Interpolate(g00, g10, fx);
+        double i2 = Interpolate(g01, g11, fx);
+        double i1x = (gx[0] + (gx[1] - gx[0]) * fx) * 0.5 + (g10 - g00);
+        double i2x = (gx[2] + (gx[3] - gx[2]) * fx) * 0.5 + (g11 - g01);
+        double i1y = (gy[0] + (gy[1] - gy[0]) * fx) * 0.5;
+        double i2y = (gy[2] + (gy[3] - gy[2]) * fx) * 0.5;
+
+        /* Interpolate along y */
+        *ddx = i1x + (i2x - i1x) * fy;
+        *ddy = i1y + (i2y - i1y) * fy + (i2 - i1);
+        return Interpolate(i1, i2, fy);
+    }
+
+    /*
+     * Calculates simplex noise at a given location. Same octave hashing as
+     * Calc_Perlin and centred on 0.5 like it, but only blends the 3 corners
+     * of a triangle. Results stay within [0, 1].
+     */
+    double Calc_Simplex(int i, double x, double y) const
+    {
+        const double F2 = 0.36602540378443864676; /* (sqrt(3) - 1) / 2 */
+        const double G2 = 0.21132486540518711775; /* (3 - sqrt(3)) / 6 */
+
+        /* Skew into the triangle grid to find the containing cell */
+        double skew = (x + y) * F2;
+        int x0 = Fast_Floor(x + skew);
+        int y0 = Fast_Floor(y + skew);
+        double unskew = (x0 + y0) * G2;
+
+        /* Distances from the three corners */
+        double dx0 = x - (x0 - unskew);
+        double dy0 = y - (y0 - unskew);
+        int stepX = dx0 > dy0 ? 1 : 0;
+        int stepY = 1 - stepX;
+        double dx1 = dx0 - stepX + G2;
+        double dy1 = dy0 - stepY + G2;
+        double dx2 = dx0 - 1 + 2 * G2;
+        double dy2 = dy0 - 1 + 2 * G2;
+
+        double total = Simplex_Corner(i, x0, y0, dx0, dy0) +
+                       Simplex_Corner(i, x0 + stepX, y0 + stepY, dx1, dy1) +
+                       Simplex_Corner(i, x0 + 1, y0 + 1, dx2, dy2);
+
+        /* The corners sum to within about +-1/98 for unit gradients, scale
+         * that to +-0.5 and centre it on 0.5 like Calc_Perlin */
+        return 49.0 * total + 0.5;
+    }
+
+    /*
+     * Calculates 3D simplex noise at a given location, blending the 4 corners
+     * of a tetrahedron. Same range as Calc_Simplex.
+     */
+    double Calc_Simplex(int i, double x, double y, double z) const
     {
+        const double F3 = 1.0 / 3.0;
+        const double G3 = 1.0 / 6.0;
+
+        /* Skew into the tetrahedral grid to find the containing cell */
+        double skew = (x + y + z) * F3;
+        int x0 = Fast_Floor(x + skew);
+        int y0 = Fast_Floor(y + skew);
+        int z0 = Fast_Floor(z + skew);
+        double unskew = (x0 + y0 + z0) * G3;
+
+        double dx0 = x - (x0 - unskew);
+        double dy0 = y - (y0 - unskew);
+        double dz0 = z - (z0 - unskew);
+
+        /* Order of the axes picks one of six tetrahedra */
+        int i1, j1, k1, i2, j2, k2;
+        if (dx0 >= dy0) {
+            if (dy0 >= dz0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+            else if (dx0 >= dz0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+            else                 { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+        }
+        else {
+            if (dy0 < dz0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+            else if (dx0 < dz0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+            else                 { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+        }
+
+        double total = Simplex_Corner(i, x0, y0, z0, dx0, dy0, dz0) +
+                       Simplex_Corner(i, x0 + i1, y0 + j1, z0 + k1,
+                                      dx0 - i1 + G3, dy0 - j1 + G3, dz0 - k1 + G3) +
+                       Simplex_Corner(i, x0 + i2, y0 + j2, z0 + k2,
+                                      dx0 - i2 + 2 * G3, dy0 - j2 + 2 * G3, dz0 - k2 + 2 * G3) +
+                       Simplex_Corner(i, x0 + 1, y0 + 1, z0 + 1,
+                                      dx0 - 1 + 3 * G3, dy0 - 1 + 3 * G3, dz0 - 1 + 3 * G3);
+
+        /* The corners sum to within about +-1/32, scale that to +-0.5 and
+         * centre it on 0.5 like Calc_Perlin */
+        return 16.0 * total + 0.5;
+    }
+
+    /*
+     * Calculates the noise of the selected engine at a given location
+     */
+    double Calc_Noise(int i, double x, double y) const
+    {
+        if (Engine == PERLIN_ENGINE_SIMPLEX)
+            return Calc_Simplex(i, x, y);
+        return Calc_Perlin(i, x, y);
+    }
+
+    double Perlin_Val(double x, double y) const
+    {
+        /* The default primes are immediates of BasicPerlin, which unrolls the octaves */
+        if (Engine == PERLIN_ENGINE_GRADIENT && Default_Primes())
+        {
+            if (HashMode == PERLIN_HASH_MIX)
+            {
+                BasicPerlin<double, 5, PerlinMixHash> basic;
+                basic.GradientMode = GradientMode;
+                return basic.Perlin_Val(x, y);
+            }
+            BasicPerlin<double> basic;
+            basic.GradientMode = GradientMode;
+            return basic.Perlin_Val(x, y);
+        }
+
         double total = 0;
         double ampl = 1;
         for (int i = 0; i <= 4; i++)
         {
-            total += Calc_Perlin(i, x / (1 << (4 + i)), y / (1 << (4 + i))) / ampl;
+            total += Calc_Noise(i, x / (1 << (4 + i)), y / (1 << (4 + i))) / ampl;
             ampl *= 2;
         }
         return total;
     }
 
-    double Perlin_Marble(double x, double y)
+    /*
+     * Sums the octaves of Perlin_Val for samples covering footprint units.
+     * Octaves finer than the footprint are replaced by their mean instead of
+     * being evaluated, and the last visible one is faded in so the result
+     * changes smoothly with distance. Same as Perlin_Val for a footprint of
+     * 16 or less.
+     */
+    double Perlin_Val_LOD(double x, double y, double footprint) const
+    {
+        double total = 0;
+        double ampl = 1;
+        for (int i = 0; i <= 4; i++)
+        {
+            double weight = Octave_Weight(1 << (4 + i), footprint);
+            if (weight <= 0)
+                total += 0.5 / ampl;
+            else if (weight >= 1)
+                total += Calc_Noise(i, x / (1 << (4 + i)), y / (1 << (4 + i))) / ampl;
+            else
+                total += (weight * Calc_Noise(i, x / (1 << (4 + i)), y / (1 << (4 + i))) +
+                          (1 - weight) * 0.5) / ampl;
+            ampl *= 2;
+        }
+        return total;
+    }
+
+    /*
+     * Sums the octaves of 3D simplex noise, with the scales of Perlin_Val.
+     * Used for volumes such as fog density regardless of Engine.
+     */
+    double Perlin_Val(double x, double y, double z) const
+    {
+        double total = 0;
+        double ampl = 1;
+        for (int i = 0; i <= 4; i++)
+        {
+            double scale = 1 << (4 + i);
+            total += Calc_Simplex(i, x / scale, y / scale, z / scale) / ampl;
+            ampl *= 2;
+        }
+        return total;
+    }
+
+    /*
+     * Effects:
+     *      Returns Perlin_Val at (x, y) and writes its analytic partial
+     *      derivatives to dx and dy, in a single pass over the octaves.
+     */
+    double Perlin_ValDeriv(double x, double y, double *dx, double *dy) const
+    {
+        double total = 0, totalX = 0, totalY = 0;
+        double ampl = 1;
+        for (int i = 0; i <= 4; i++)
+        {
+            double scale = 1 << (4 + i);
+            double octaveX, octaveY;
+            total += Calc_PerlinDeriv(i, x / scale, y / scale, &octaveX, &octaveY) / ampl;
+
+            /* Chain rule for the octave's scaling */
+            totalX += octaveX / (scale * ampl);
+            totalY += octaveY / (scale * ampl);
+            ampl *= 2;
+        }
+        *dx = totalX;
+        *dy = totalY;
+        return total;
+    }
+
+    double Perlin_Marble(double x, double y) const
     {   
         double val = x * xPeriod / Width + y * yPeriod / Height +
             power * Turbulence(x, y, size);
         return abs(sin(val * 3.141592));
     }
-};
\ No newline at end of file
+
+    /*
+     * Calculates the marble pattern for samples covering footprint units,
+     * skipping turbulence octaves that cannot be seen (see Turbulence_LOD)
+     */
+    double Perlin_Marble_LOD(double x, double y, double footprint) const
+    {
+        double val = x * xPeriod / Width + y * yPeriod / Height +
+            power * Turbulence_LOD(x, y, size, footprint);
+        return abs(sin(val * 3.141592));
+    }
+
+    /*
+     * Requires:
+     *      xs, ys and out hold at least count values.
+     *
+     * Effects:
+     *      Writes Perlin_Val of every (xs[i], ys[i]) pair to out[i], several
+     *      samples at a time. Matches Perlin_Val to within 1e-12 (exactly with
+     *      PERLIN_GRADIENT_TABLE); every instruction set gives bit-identical
+     *      results.
+     */
+    void Perlin_Val_Batch(const double *xs, const double *ys, double *out, int count) const
+    {
+        /* The batch kernels only cover the gradient engine */
+        if (Engine != PERLIN_ENGINE_GRADIENT)
+        {
+            for (int i = 0; i < count; i++)
+                out[i] = Perlin_Val(xs[i], ys[i]);
+            return;
+        }
+        Perlin_Val_Batch_Dispatch(Batch_Params(), xs, ys, out, count);
+    }
+
+    /*
+     * Requires:
+     *      xs, ys and out hold at least count values.
+     *
+     * Effects:
+     *      Writes Perlin_Marble of every (xs[i], ys[i]) pair to out[i], several
+     *      samples at a time. Matches Perlin_Marble to within 1e-12; every
+     *      instruction set gives bit-identical results.
+     */
+    void Perlin_Marble_Batch(const double *xs, const double *ys, double *out, int count) const
+    {
+        Perlin_Marble_Batch_Dispatch(Batch_Params(), xs, ys, out, count);
+    }
+
+    /*
+     * Requires:
+     *      xs, ys and out hold at least count values.
+     *
+     * Effects:
+     *      Writes Perlin_Marble_LOD of every (xs[i], ys[i]) pair for the given
+     *      footprint to out[i]. The turbulence is summed sample by sample and
+     *      the marble finished several samples at a time, matching
+     *      Perlin_Marble_LOD to within 1e-12.
+     */
+    void Perlin_Marble_LOD_Batch(const double *xs, const double *ys, double footprint, double *out,
+                                 int count) const
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = Turbulence_LOD(xs[i], ys[i], size, footprint);
+        Perlin_Marble_Finish_Dispatch(Batch_Params(), xs, ys, out, out, count);
+    }
+
+    /*
+     * Requires:
+     *      out holds at least count values.
+     *
+     * Effects:
+     *      Writes Perlin_Marble of the count pixels starting at (x, y) and
+     *      moving along the row to out.
+     */
+    void Perlin_Marble_Row(int x, int y, double *out, int count) const
+    {
+        double xs[64], ys[64];
+        for (int i = 0; i < 64; i++)
+            ys[i] = y;
+
+        /* Evaluate in blocks that fit on the stack */
+        for (int start = 0; start < count; start += 64)
+        {
+            int block = count - start < 64 ? count - start : 64;
+            for (int i = 0; i < block; i++)
+                xs[i] = x + start + i;
+            Perlin_Marble_Batch(xs, ys, out + start, block);
+        }
+    }
+
+    /*
+     * Requires:
+     *      out holds at least width * height values, x0 and y0 are not
+     *      negative.
+     *
+     * Effects:
+     *      Writes Perlin_Marble of the width x height pixels starting at
+     *      (x0, y0) to out, one row after another. The turbulence octaves
+     *      are built once as a TurbulencePyramid and streamed row by row.
+     *      Matches Perlin_Marble to within 1e-12.
+     */
+    void Perlin_Marble_Region(int x0, int y0, int width, int height, double *out) const
+    {
+        if (width <= 0 || height <= 0)
+            return;
+
+        TurbulencePyramid pyramid(NoiseGrid, Height, Width, x0, y0, width, height, size);
+        PerlinBatchParams params = Batch_Params();
+
+        double *xs = new double[width];
+        double *ys = new double[width];
+        for (int i = 0; i < width; i++)
+            xs[i] = x0 + i;
+
+        for (int row = 0; row < height; row++)
+        {
+            double *line = out + (size_t)row * width;
+            for (int i = 0; i < width; i++)
+                ys[i] = y0 + row;
+            pyramid.Turbulence_Row(row, line);
+            Perlin_Marble_Finish_Dispatch(params, xs, ys, line, line, width);
+        }
+
+        delete[] xs;
+        delete[] ys;
+    }
+
+private:
+    /* Allocates an uninitialized, aligned height x width grid */
+    static double *Allocate_Grid(int height, int width)
+    {
+        size_t bytes = (size_t)height * width * sizeof(double);
+        return (double *) operator new[](bytes, std::align_val_t(GRID_ALIGNMENT));
+    }
+
+    /* Frees a grid from Allocate_Grid */
+    static void Free_Grid(double *grid)
+    {
+        if (grid)
+            operator delete[](grid, std::align_val_t(GRID_ALIGNMENT));
+    }
+
+    /* Sets the wraparound masks from Height and Width */
+    void Compute_Masks()
+    {
+        HeightMask = (Height > 0 && (Height & (Height - 1)) == 0) ? Height - 1 : -1;
+        WidthMask = (Width > 0 && (Width & (Width - 1)) == 0) ? Width - 1 : -1;
+    }
+
+    /* Copies every field except the noise grid */
+    void Copy_Fields(const Perlin &other)
+    {
+        memcpy(Primes, other.Primes, sizeof(Primes));
+        Prime_index = other.Prime_index;
+        xPeriod = other.xPeriod;
+        yPeriod = other.yPeriod;
+        power = other.power;
+        size = other.size;
+        Height = other.Height;
+        Width = other.Width;
+        HeightMask = other.HeightMask;
+        WidthMask = other.WidthMask;
+        GradientMode = other.GradientMode;
+        Engine = other.Engine;
+        HashMode = other.HashMode;
+        Seed = other.Seed;
+    }
+
+    /* Packs the fields the batch kernels read */
+    PerlinBatchParams Batch_Params() const
+    {
+        PerlinBatchParams p;
+        p.Primes = Primes;
+        p.GradientMode = GradientMode;
+        p.HashMode = HashMode;
+        p.GradX = Gradient_Table().X;
+        p.GradY = Gradient_Table().Y;
+        p.NoiseGrid = NoiseGrid;
+        p.Height = Height;
+        p.Width = Width;
+        p.HeightMask = HeightMask;
+        p.WidthMask = WidthMask;
+        p.xPeriod = xPeriod;
+        p.yPeriod = yPeriod;
+        p.power = power;
+        p.size = size;
+        return p;
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+/* Header file for evaluating Perlin noise on the GPU with transform feedback */
+
+#ifndef PERLIN_FEEDBACK_H
+#define PERLIN_FEEDBACK_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <iostream>
+
+#include "perlin.h"
+#include "shaders/shader_s.h"
+
+/*
+ * Vertex program evaluating Perlin::Perlin_Val for a grid of samples. Every
+ * vertex computes one sample and its height is captured with transform
+ * feedback straight into a buffer, so chunk heightfields never pass through
+ * the CPU. The origin reaches the program as an integer cell and a fractional
+ * offset, so heights match Perlin_Val to single precision wherever the grid
+ * lies; only the grid's own extent, columns * spacing, is held in floats.
+ */
+class PerlinFeedback
+{
+public:
+    unsigned int ID;
+
+    /*
+     * Effects:
+     *      Builds the program from vertexPath and fragmentPath through Shader,
+     *      out of assets or from disk, and relinks it with Height as its
+     *      captured output. ID is 0 if that fails.
+     */
+    PerlinFeedback(const AssetArchive &assets, const char *vertexPath, const char *fragmentPath)
+    {
+        ID = 0;
+        glGenVertexArrays(1, &VAO);
+
+        /* Capture the height, which takes effect on the next link */
+        Shader shader(assets, vertexPath, fragmentPath);
+        const char *varyings[1] = {"Height"};
+        glTransformFeedbackVaryings(shader.ID, 1, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(shader.ID);
+
+        int linked;
+        glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            std::cout << "Error when linking noise feedback shader: " << vertexPath << std::endl;
+            glDeleteProgram(shader.ID);
+            return;
+        }
+        ID = shader.ID;
+    }
+
+    ~PerlinFeedback()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        if (ID)
+            glDeleteProgram(ID);
+    }
+
+    PerlinFeedback(const PerlinFeedback &) = delete;
+    PerlinFeedback &operator=(const PerlinFeedback &) = delete;
+
+    /*
+     * Requires:
+     *      buffer is a buffer object holding at least columns * rows floats.
+     *
+     * Effects:
+     *      Writes Perlin_Val of perlin at (originX + i * spacing,
+     *      originY + j * spacing) to float j * columns + i of buffer, for
+     *      every column i and row j. Returns 0 on success and -1 if the
+     *      program is unavailable or perlin does not use the gradient engine.
+     *      Nothing is read back; the heights can be drawn from buffer as soon
+     *      as the commands run.
+     */
+    int Evaluate(const Perlin &perlin, unsigned int buffer, double originX, double originY,
+                 float spacing, int columns, int rows)
+    {
+        if (!ID || perlin.Engine != PERLIN_ENGINE_GRADIENT || columns <= 0 || rows <= 0)
+            return -1;
+
+        /* Noise settings */
+        glUseProgram(ID);
+        int cellX = (int)floor(originX), cellY = (int)floor(originY);
+        glUniform2i(glGetUniformLocation(ID, "originCell"), cellX, cellY);
+        glUniform2f(glGetUniformLocation(ID, "originOffset"), (float)(originX - cellX), (float)(originY - cellY));
+        glUniform1f(glGetUniformLocation(ID, "spacing"), spacing);
+        glUniform1i(glGetUniformLocation(ID, "columns"), columns);
+        glUniform1iv(glGetUniformLocation(ID, "primes"), 15, perlin.Primes);
+        glUniform1i(glGetUniformLocation(ID, "gradientMode"), perlin.GradientMode);
+        glUniform1i(glGetUniformLocation(ID, "hashMode"), perlin.HashMode);
+        if (perlin.GradientMode == PERLIN_GRADIENT_TABLE && !GradientsSet)
+        {
+            const PerlinGradientTable &table = Perlin::Gradient_Table();
+            float gradients[2 * PerlinGradientTable::SIZE];
+            for (int k = 0; k < PerlinGradientTable::SIZE; k++)
+            {
+                gradients[2 * k] = (float)table.X[k];
+                gradients[2 * k + 1] = (float)table.Y[k];
+            }
+            glUniform2fv(glGetUniformLocation(ID, "gradients"), PerlinGradientTable::SIZE, gradients);
+            GradientsSet = true;
+        }
+
+        /* One point per sample, nothing rasterized */
+        glBindVertexArray(VAO);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, columns * rows);
+        glEndTransformFeedback();
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        return 0;
+    }
+
+private:
+    unsigned int VAO;           /* Empty vertex array, samples come from gl_VertexID */
+    bool GradientsSet = false;  /* Gradient table uploaded to the program */
+};
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Batch kernels for the Perlin class.
+ *
+ * This file is included once per lane type by perlin_simd.h, inside a
+ * namespace that provides VD (doubles), VI (32 bit integers), VM (masks)
+ * and LANES. Every lane type performs the same IEEE operations in the same
+ * order, and perlin_simd.h keeps GCC from fusing any of them, so each
+ * instruction set gives bit-identical results. bench_perlin checks this.
+ */
+
+/*
+ * Effects:
+ *      Calculates the sine and cosine of theta with a shared polynomial.
+ *      Accurate to a couple of ulp for the angles produced by Cos_Noise.
+ */
+inline void Sin_Cos(VD theta, VD *sinOut, VD *cosOut)
+{
+    /* Reduce to [-pi/4, pi/4] around the nearest multiple of pi/2 */
+    VD k = round_d(theta * VD(6.36619772367581382433e-01));
+    VD r = (theta - k * VD(1.57079632673412561417e+00)) - k * VD(6.07710050650619224932e-11);
+    VD z = r * r;
+
+    /* Sine and cosine kernels on the reduced angle */
+    VD ps = VD(-2.50507602534068634195e-08) + z * VD(1.58969099521155010221e-10);
+    ps = VD(2.75573137070700676789e-06) + z * ps;
+    ps = VD(-1.98412698298579493134e-04) + z * ps;
+    ps = VD(8.33333333332248946124e-03) + z * ps;
+    ps = VD(-1.66666666666666324348e-01) + z * ps;
+    VD s = r + (z * r) * ps;
+
+    VD pc = VD(2.08757232129817482790e-09) + z * VD(-1.13596475577881948265e-11);
+    pc = VD(-2.75573143513906633035e-07) + z * pc;
+    pc = VD(2.48015872894767294178e-05) + z * pc;
+    pc = VD(-1.38888888888741095749e-03) + z * pc;
+    pc = VD(4.16666666666666019037e-02) + z * pc;
+    VD c = (VD(1.0) - VD(0.5) * z) + (z * z) * pc;
+
+    /* Quadrant of the angle */
+    VD half = k * VD(0.5);
+    VM odd = cmp_neq(half, floor_d(half));
+    VD q = k - VD(4.0) * floor_d(k * VD(0.25));
+
+    VD sv = select_d(odd, c, s);
+    VD cv = select_d(odd, s, c);
+    *sinOut = select_d(cmp_ge(q, VD(2.0)), neg_d(sv), sv);
+    *cosOut = select_d(cmp_lt(abs_d(q - VD(1.5)), VD(1.0)), neg_d(cv), cv);
+}
+
+/*
+ * Effects:
+ *      Calculates the absolute value of the sine of theta.
+ */
+inline VD Abs_Sin(VD theta)
+{
+    VD s, c;
+    Sin_Cos(theta, &s, &c);
+    return abs_d(s);
+}
+
+/*
+ * Effects:
+ *      Generates the 30 bit hash of a 2D grid point, as PerlinMixHash::Mix.
+ */
+inline VI Mix_Hash(int32_t key, VI x, VI y)
+{
+    VI h = add_i(add_i(mul_i(x, set_i((int32_t)0x9e3779b1u)), mul_i(y, set_i((int32_t)0x85ebca77u))),
+                 set_i(key));
+    h = xor_i(h, shr_i(h, 16));
+    h = mul_i(h, set_i((int32_t)0x7feb352du));
+    h = xor_i(h, shr_i(h, 15));
+    h = mul_i(h, set_i((int32_t)0x846ca68bu));
+    h = xor_i(h, shr_i(h, 16));
+    return shr_i(h, 2);
+}
+
+/*
+ * Effects:
+ *      Generates the 30 bit hash of a grid point, as Hash.
+ */
+inline VI Hash(const PerlinBatchParams &p, int i, VI x, VI y)
+{
+    if (p.HashMode == PERLIN_HASH_MIX)
+        return Mix_Hash(p.Primes[i * 3], x, y);
+
+    VI n = add_i(x, mul_i(y, set_i(59)));
+    n = xor_i(shl_i(n, 13), n);
+    VI a = set_i(p.Primes[i * 3]), b = set_i(p.Primes[i * 3 + 1]), c = set_i(p.Primes[i * 3 + 2]);
+    return and_i(add_i(mul_i(n, add_i(mul_i(mul_i(n, n), a), b)), c), set_i(0x3fffffff));
+}
+
+/*
+ * Effects:
+ *      Generates pseudorandom noise value between 0 and 2pi, as Cos_Noise.
+ */
+inline VD Cos_Noise(const PerlinBatchParams &p, int i, VI x, VI y)
+{
+    VD rand = VD(2.0) - cvt_d(Hash(p, i, x, y)) / VD(1 << 29);
+    return rand * VD(3.14159265);
+}
+
+/*
+ * Effects:
+ *      Calculates the dot product with the gradient, as Gradient.
+ */
+inline VD Gradient(const PerlinBatchParams &p, int i, VI ix, VI iy, VD x, VD y)
+{
+    VD dx = x - cvt_d(ix);
+    VD dy = y - cvt_d(iy);
+
+    VD s, c;
+    if (p.GradientMode == PERLIN_GRADIENT_TABLE)
+    {
+        VI k = shr_i(Hash(p, i, ix, iy), 22);
+        c = gather_d(p.GradX, k);
+        s = gather_d(p.GradY, k);
+    }
+    else
+        Sin_Cos(Cos_Noise(p, i, ix, iy), &s, &c);
+
+    return (dx * c + dy * s) * VD(0.5) + VD(0.5);
+}
+
+/*
+ * Effects:
+ *      Interpolates between two values, as Interpolate.
+ */
+inline VD Interpolate(VD a, VD b, VD w)
+{
+    w = select_d(cmp_gt(w, VD(1.0)), VD(1.0), w);
+    w = select_d(cmp_lt(w, VD(0.0)), VD(0.0), w);
+    return (b - a) * w + a;
+}
+
+/*
+ * Effects:
+ *      Calculates perlin at a given location, as Calc_Perlin.
+ */
+inline VD Calc_Perlin(const PerlinBatchParams &p, int i, VD x, VD y)
+{
+    VI x0 = cvtt_i(floor_d(x));
+    VI x1 = add_i(x0, set_i(1));
+    VI y0 = cvtt_i(floor_d(y));
+    VI y1 = add_i(y0, set_i(1));
+
+    VD fx = x - cvt_d(x0);
+    VD fy = y - cvt_d(y0);
+
+    VD i1 = Interpolate(Gradient(p, i, x0, y0, x, y), Gradient(p, i, x1, y0, x, y), fx);
+    VD i2 = Interpolate(Gradient(p, i, x0, y1, x, y), Gradient(p, i, x1, y1, x, y), fx);
+
+    return Interpolate(i1, i2, fy);
+}
+
+/*
+ * Effects:
+ *      Sums five octaves of perlin, as Perlin_Val.
+ */
+inline VD Perlin_Val(const PerlinBatchParams &p, VD x, VD y)
+{
+    VD total = VD(0.0);
+    double ampl = 1;
+    for (int i = 0; i <= 4; i++)
+    {
+        VD scale = VD(1 << (4 + i));
+        total = total + Calc_Perlin(p, i, x / scale, y / scale) / VD(ampl);
+        ampl *= 2;
+    }
+    return total;
+}
+
+/*
+ * Effects:
+ *      Returns the smoothed noise value, as SmoothNoise.
+ */
+inline VD SmoothNoise(const PerlinBatchParams &p, VD x, VD y)
+{
+    VI iX1 = cvtt_i(x);
+    VI iY1 = cvtt_i(y);
+
+    VD fX = x - cvt_d(iX1);
+    VD fY = y - cvt_d(iY1);
+
+    /* Wrap around the grid, same as SmoothNoise for every in-range index */
+    VI iX2, iY2;
+    if (p.WidthMask >= 0)
+    {
+        iX2 = and_i(add_i(iX1, set_i(-1)), set_i(p.WidthMask));
+        iX1 = and_i(iX1, set_i(p.WidthMask));
+    }
+    else
+        iX2 = wrap_i(add_i(iX1, set_i(-1)), p.Width);
+    if (p.HeightMask >= 0)
+    {
+        iY2 = and_i(add_i(iY1, set_i(-1)), set_i(p.HeightMask));
+        iY1 = and_i(iY1, set_i(p.HeightMask));
+    }
+    else
+        iY2 = wrap_i(add_i(iY1, set_i(-1)), p.Height);
+
+    /* Offsets of the rows in the grid */
+    VI row1 = mul_i(iY1, set_i(p.Width));
+    VI row2 = mul_i(iY2, set_i(p.Width));
+
+    VD total = VD(0.0);
+    total = total + fX * fY * gather_d(p.NoiseGrid, add_i(row1, iX1));
+    total = total + (VD(1.0) - fX) * fY * gather_d(p.NoiseGrid, add_i(row1, iX2));
+    total = total + fX * (VD(1.0) - fY) * gather_d(p.NoiseGrid, add_i(row2, iX1));
+    total = total + (VD(1.0) - fX) * (VD(1.0) - fY) * gather_d(p.NoiseGrid, add_i(row2, iX2));
+
+    return total;
+}
+
+/*
+ * Effects:
+ *      Calculates the turbulence noise, as Turbulence.
+ */
+inline VD Turbulence(const PerlinBatchParams &p, VD x, VD y, double size)
+{
+    VD total = VD(0.0);
+    double sizeWalker = size;
+
+    while (sizeWalker >= 1)
+    {
+        total = total + SmoothNoise(p, x / VD(sizeWalker), y / VD(sizeWalker)) * VD(sizeWalker);
+        sizeWalker /= 2;
+    }
+
+    return total / VD(size) / VD(2.0);
+}
+
+/*
+ * Effects:
+ *      Calculates the marble pattern, as Perlin_Marble.
+ */
+inline VD Perlin_Marble(const PerlinBatchParams &p, VD x, VD y)
+{
+    VD val = x * VD(p.xPeriod) / VD(p.Width) + y * VD(p.yPeriod) / VD(p.Height) +
+             VD(p.power) * Turbulence(p, x, y, p.size);
+    return Abs_Sin(val * VD(3.141592));
+}
+
+/*
+ * Effects:
+ *      Evaluates Perlin_Val over whole registers and returns how many of the
+ *      count values were written.
+ */
+inline int Perlin_Val_Batch(const PerlinBatchParams &p, const double *xs, const double *ys,
+                            double *out, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+        store_d(out + i, Perlin_Val(p, load_d(xs + i), load_d(ys + i)));
+    return i;
+}
+
+/*
+ * Effects:
+ *      Evaluates Perlin_Marble over whole registers and returns how many of
+ *      the count values were written.
+ */
+inline int Perlin_Marble_Batch(const PerlinBatchParams &p, const double *xs, const double *ys,
+                               double *out, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+        store_d(out + i, Perlin_Marble(p, load_d(xs + i), load_d(ys + i)));
+    return i;
+}
+
+/*
+ * Effects:
+ *      Finishes the marble pattern from turbulence already evaluated at
+ *      (xs[i], ys[i]), as Perlin_Marble, and returns how many of the count
+ *      values were written. out may alias turbulence.
+ */
+inline int Perlin_Marble_Finish_Batch(const PerlinBatchParams &p, const double *xs, const double *ys,
+                                      const double *turbulence, double *out, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+    {
+        VD x = load_d(xs + i), y = load_d(ys + i);
+        VD val = x * VD(p.xPeriod) / VD(p.Width) + y * VD(p.yPeriod) / VD(p.Height) +
+                 VD(p.power) * load_d(turbulence + i);
+        store_d(out + i, Abs_Sin(val * VD(3.141592)));
+    }
+    return i;
+}
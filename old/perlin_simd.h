@@ -0,0 +1,358 @@
+/* Header file for the batch (SIMD) evaluation of Perlin and Worley noise */
+
+#ifndef PERLIN_SIMD_H
+#define PERLIN_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+
+#include "basic_perlin.h"
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define PERLIN_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/* Instruction sets the batch kernels can be dispatched to */
+enum PerlinSimdLevel
+{
+    PERLIN_SIMD_SCALAR = 0,
+    PERLIN_SIMD_SSE41 = 1,
+    PERLIN_SIMD_AVX2 = 2,
+};
+
+/*
+ * Everything the batch kernels need to know about a Perlin instance.
+ */
+struct PerlinBatchParams
+{
+    const int *Primes;
+    int GradientMode;
+    int HashMode;
+    const double *GradX;
+    const double *GradY;
+    const double *NoiseGrid;
+    int Height;
+    int Width;
+    int HeightMask;
+    int WidthMask;
+    double xPeriod;
+    double yPeriod;
+    double power;
+    double size;
+};
+
+/*
+ * Everything the cellular kernels need to know about a Worley instance.
+ */
+struct WorleyBatchParams
+{
+    int32_t Key;
+    int CellsX;
+    int CellsY;
+};
+
+/*
+ * Effects:
+ *      Returns the best instruction set supported by the running CPU.
+ */
+inline int Perlin_Simd_Detect()
+{
+#ifdef PERLIN_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return PERLIN_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return PERLIN_SIMD_SSE41;
+#endif
+    return PERLIN_SIMD_SCALAR;
+}
+
+/*
+ * Effects:
+ *      Returns the instruction set used by the batch kernels. Detected once,
+ *      and may be lowered by assigning to it (e.g. to compare against scalar).
+ */
+inline int &Perlin_Simd_Level()
+{
+    static int level = Perlin_Simd_Detect();
+    return level;
+}
+
+/*
+ * The lanes only agree bit for bit if none of them fuses a multiply and add,
+ * which GCC does by default once FMA is enabled (e.g. -march=native).
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+ * Scalar lanes. Also evaluates the tail of every SIMD batch.
+ */
+namespace perlin_scalar
+{
+    const int LANES = 1;
+    typedef double VD;
+    typedef int32_t VI;
+    typedef bool VM;
+
+    inline VD load_d(const double *p) { return *p; }
+    inline void store_d(double *p, VD v) { *p = v; }
+    inline VD floor_d(VD v) { return std::floor(v); }
+    inline VD round_d(VD v) { return std::nearbyint(v); }
+    inline VD abs_d(VD v) { return std::fabs(v); }
+    inline VD sqrt_d(VD v) { return std::sqrt(v); }
+    inline VD neg_d(VD v) { return -v; }
+    inline VM cmp_lt(VD a, VD b) { return a < b; }
+    inline VM cmp_gt(VD a, VD b) { return a > b; }
+    inline VM cmp_ge(VD a, VD b) { return a >= b; }
+    inline VM cmp_neq(VD a, VD b) { return a != b; }
+    inline VD select_d(VM m, VD a, VD b) { return m ? a : b; }
+
+    /* Integer lanes wrap on overflow, like the SIMD registers do */
+    inline VI set_i(int32_t v) { return v; }
+    inline VI add_i(VI a, VI b) { return (int32_t)((uint32_t)a + (uint32_t)b); }
+    inline VI mul_i(VI a, VI b) { return (int32_t)((uint32_t)a * (uint32_t)b); }
+    inline VI shl_i(VI a, int s) { return (int32_t)((uint32_t)a << s); }
+    inline VI shr_i(VI a, int s) { return (int32_t)((uint32_t)a >> s); }
+    inline VI xor_i(VI a, VI b) { return a ^ b; }
+    inline VI and_i(VI a, VI b) { return a & b; }
+    inline VI wrap_i(VI a, int m) { return a < 0 ? a + m : a; }
+    inline VI cvtt_i(VD v) { return (int32_t)v; }
+    inline VD cvt_d(VI v) { return (double)v; }
+
+    inline VD gather_d(const double *table, VI index)
+    {
+        return table[index];
+    }
+
+#include "perlin_kernel.inl"
+#include "worley_kernel.inl"
+}
+
+#ifdef PERLIN_SIMD_X86
+
+/*
+ * SSE4.1 lanes, two doubles per register.
+ */
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+namespace perlin_sse41
+{
+    const int LANES = 2;
+    typedef __m128i VI;
+
+    struct VD
+    {
+        __m128d v;
+        VD() {}
+        VD(__m128d x) : v(x) {}
+        VD(double d) : v(_mm_set1_pd(d)) {}
+    };
+    typedef VD VM;
+
+    inline VD operator+(VD a, VD b) { return _mm_add_pd(a.v, b.v); }
+    inline VD operator-(VD a, VD b) { return _mm_sub_pd(a.v, b.v); }
+    inline VD operator*(VD a, VD b) { return _mm_mul_pd(a.v, b.v); }
+    inline VD operator/(VD a, VD b) { return _mm_div_pd(a.v, b.v); }
+
+    inline VD load_d(const double *p) { return _mm_loadu_pd(p); }
+    inline void store_d(double *p, VD v) { _mm_storeu_pd(p, v.v); }
+    inline VD floor_d(VD v) { return _mm_floor_pd(v.v); }
+    inline VD round_d(VD v) { return _mm_round_pd(v.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    inline VD abs_d(VD v) { return _mm_andnot_pd(_mm_set1_pd(-0.0), v.v); }
+    inline VD sqrt_d(VD v) { return _mm_sqrt_pd(v.v); }
+    inline VD neg_d(VD v) { return _mm_xor_pd(_mm_set1_pd(-0.0), v.v); }
+    inline VM cmp_lt(VD a, VD b) { return _mm_cmplt_pd(a.v, b.v); }
+    inline VM cmp_gt(VD a, VD b) { return _mm_cmpgt_pd(a.v, b.v); }
+    inline VM cmp_ge(VD a, VD b) { return _mm_cmpge_pd(a.v, b.v); }
+    inline VM cmp_neq(VD a, VD b) { return _mm_cmpneq_pd(a.v, b.v); }
+    inline VD select_d(VM m, VD a, VD b) { return _mm_blendv_pd(b.v, a.v, m.v); }
+
+    inline VI set_i(int32_t v) { return _mm_set1_epi32(v); }
+    inline VI add_i(VI a, VI b) { return _mm_add_epi32(a, b); }
+    inline VI mul_i(VI a, VI b) { return _mm_mullo_epi32(a, b); }
+    inline VI shl_i(VI a, int s) { return _mm_slli_epi32(a, s); }
+    inline VI shr_i(VI a, int s) { return _mm_srli_epi32(a, s); }
+    inline VI xor_i(VI a, VI b) { return _mm_xor_si128(a, b); }
+    inline VI and_i(VI a, VI b) { return _mm_and_si128(a, b); }
+    inline VI cvtt_i(VD v) { return _mm_cvttpd_epi32(v.v); }
+    inline VD cvt_d(VI v) { return _mm_cvtepi32_pd(v); }
+
+    inline VI wrap_i(VI a, int m)
+    {
+        return _mm_add_epi32(a, _mm_and_si128(_mm_cmplt_epi32(a, _mm_setzero_si128()), _mm_set1_epi32(m)));
+    }
+
+    inline VD gather_d(const double *table, VI index)
+    {
+        return _mm_setr_pd(table[_mm_extract_epi32(index, 0)], table[_mm_extract_epi32(index, 1)]);
+    }
+
+#include "perlin_kernel.inl"
+#include "worley_kernel.inl"
+}
+#pragma GCC pop_options
+
+/*
+ * AVX2 lanes, four doubles per register. Integer lanes stay in SSE registers
+ * since four 32 bit values fit in one.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace perlin_avx2
+{
+    const int LANES = 4;
+    typedef __m128i VI;
+
+    struct VD
+    {
+        __m256d v;
+        VD() {}
+        VD(__m256d x) : v(x) {}
+        VD(double d) : v(_mm256_set1_pd(d)) {}
+    };
+    typedef VD VM;
+
+    inline VD operator+(VD a, VD b) { return _mm256_add_pd(a.v, b.v); }
+    inline VD operator-(VD a, VD b) { return _mm256_sub_pd(a.v, b.v); }
+    inline VD operator*(VD a, VD b) { return _mm256_mul_pd(a.v, b.v); }
+    inline VD operator/(VD a, VD b) { return _mm256_div_pd(a.v, b.v); }
+
+    inline VD load_d(const double *p) { return _mm256_loadu_pd(p); }
+    inline void store_d(double *p, VD v) { _mm256_storeu_pd(p, v.v); }
+    inline VD floor_d(VD v) { return _mm256_floor_pd(v.v); }
+    inline VD round_d(VD v) { return _mm256_round_pd(v.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    inline VD abs_d(VD v) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v.v); }
+    inline VD sqrt_d(VD v) { return _mm256_sqrt_pd(v.v); }
+    inline VD neg_d(VD v) { return _mm256_xor_pd(_mm256_set1_pd(-0.0), v.v); }
+    inline VM cmp_lt(VD a, VD b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+    inline VM cmp_gt(VD a, VD b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+    inline VM cmp_ge(VD a, VD b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+    inline VM cmp_neq(VD a, VD b) { return _mm256_cmp_pd(a.v, b.v, _CMP_NEQ_UQ); }
+    inline VD select_d(VM m, VD a, VD b) { return _mm256_blendv_pd(b.v, a.v, m.v); }
+
+    inline VI set_i(int32_t v) { return _mm_set1_epi32(v); }
+    inline VI add_i(VI a, VI b) { return _mm_add_epi32(a, b); }
+    inline VI mul_i(VI a, VI b) { return _mm_mullo_epi32(a, b); }
+    inline VI shl_i(VI a, int s) { return _mm_slli_epi32(a, s); }
+    inline VI shr_i(VI a, int s) { return _mm_srli_epi32(a, s); }
+    inline VI xor_i(VI a, VI b) { return _mm_xor_si128(a, b); }
+    inline VI and_i(VI a, VI b) { return _mm_and_si128(a, b); }
+    inline VI cvtt_i(VD v) { return _mm256_cvttpd_epi32(v.v); }
+    inline VD cvt_d(VI v) { return _mm256_cvtepi32_pd(v); }
+
+    inline VI wrap_i(VI a, int m)
+    {
+        return _mm_add_epi32(a, _mm_and_si128(_mm_cmplt_epi32(a, _mm_setzero_si128()), _mm_set1_epi32(m)));
+    }
+
+    inline VD gather_d(const double *table, VI index)
+    {
+        /* Masked form, the plain one trips -Wmaybe-uninitialized */
+        __m256d ones = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, index, ones, 8);
+    }
+
+#include "perlin_kernel.inl"
+#include "worley_kernel.inl"
+}
+#pragma GCC pop_options
+
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+/*
+ * Requires:
+ *      xs, ys and out hold at least count values.
+ *
+ * Effects:
+ *      Evaluates Perlin_Val for every coordinate pair using the widest
+ *      available kernel. The remainder is finished with scalar lanes.
+ */
+inline void Perlin_Val_Batch_Dispatch(const PerlinBatchParams &p, const double *xs,
+                                      const double *ys, double *out, int count)
+{
+    int done = 0;
+#ifdef PERLIN_SIMD_X86
+    if (Perlin_Simd_Level() >= PERLIN_SIMD_AVX2)
+        done = perlin_avx2::Perlin_Val_Batch(p, xs, ys, out, count);
+    else if (Perlin_Simd_Level() >= PERLIN_SIMD_SSE41)
+        done = perlin_sse41::Perlin_Val_Batch(p, xs, ys, out, count);
+#endif
+    perlin_scalar::Perlin_Val_Batch(p, xs + done, ys + done, out + done, count - done);
+}
+
+/*
+ * Requires:
+ *      xs, ys and out hold at least count values.
+ *
+ * Effects:
+ *      Evaluates Perlin_Marble for every coordinate pair using the widest
+ *      available kernel. The remainder is finished with scalar lanes.
+ */
+inline void Perlin_Marble_Batch_Dispatch(const PerlinBatchParams &p, const double *xs,
+                                         const double *ys, double *out, int count)
+{
+    int done = 0;
+#ifdef PERLIN_SIMD_X86
+    if (Perlin_Simd_Level() >= PERLIN_SIMD_AVX2)
+        done = perlin_avx2::Perlin_Marble_Batch(p, xs, ys, out, count);
+    else if (Perlin_Simd_Level() >= PERLIN_SIMD_SSE41)
+        done = perlin_sse41::Perlin_Marble_Batch(p, xs, ys, out, count);
+#endif
+    perlin_scalar::Perlin_Marble_Batch(p, xs + done, ys + done, out + done, count - done);
+}
+
+
+/*
+ * Requires:
+ *      xs, ys, turbulence and out hold at least count values.
+ *
+ * Effects:
+ *      Finishes Perlin_Marble from the turbulence at every coordinate pair
+ *      using the widest available kernel. out may alias turbulence.
+ */
+inline void Perlin_Marble_Finish_Dispatch(const PerlinBatchParams &p, const double *xs,
+                                          const double *ys, const double *turbulence,
+                                          double *out, int count)
+{
+    int done = 0;
+#ifdef PERLIN_SIMD_X86
+    if (Perlin_Simd_Level() >= PERLIN_SIMD_AVX2)
+        done = perlin_avx2::Perlin_Marble_Finish_Batch(p, xs, ys, turbulence, out, count);
+    else if (Perlin_Simd_Level() >= PERLIN_SIMD_SSE41)
+        done = perlin_sse41::Perlin_Marble_Finish_Batch(p, xs, ys, turbulence, out, count);
+#endif
+    perlin_scalar::Perlin_Marble_Finish_Batch(p, xs + done, ys + done, turbulence + done,
+                                              out + done, count - done);
+}
+
+/*
+ * Requires:
+ *      xs, ys, f1, f2 and cell hold at least count values.
+ *
+ * Effects:
+ *      Evaluates Worley::Worley_Val for every coordinate pair using the
+ *      widest available kernel. The remainder is finished with scalar lanes.
+ */
+inline void Worley_Batch_Dispatch(const WorleyBatchParams &p, const double *xs, const double *ys,
+                                  double *f1, double *f2, double *cell, int count)
+{
+    int done = 0;
+#ifdef PERLIN_SIMD_X86
+    if (Perlin_Simd_Level() >= PERLIN_SIMD_AVX2)
+        done = perlin_avx2::Worley_Batch(p, xs, ys, f1, f2, cell, count);
+    else if (Perlin_Simd_Level() >= PERLIN_SIMD_SSE41)
+        done = perlin_sse41::Worley_Batch(p, xs, ys, f1, f2, cell, count);
+#endif
+    perlin_scalar::Worley_Batch(p, xs + done, ys + done, f1 + done, f2 + done, cell + done,
+                                count - done);
+}
+
+#endif
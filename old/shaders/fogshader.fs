@@ -3,19 +3,27 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 in vec3 FragPos;
+flat in float Layer;
 
 uniform vec3 fogColor;
 uniform vec3 viewSource;
-uniform sampler2D textureID;
+uniform sampler2DArray materials;   // Ground, wood and stone layers
+uniform sampler3D fogVolume;   // Tiling fog density, 0 to 1
+uniform float fogTileSize;     // World units covered by one tile of the volume
+uniform vec3 fogOffset;        // Scroll of the volume, in tiles
 uniform float fogDistance;
 
 void main()
 {
     // Fog intensity
     float distance = length(viewSource - FragPos);
-    float intensity = clamp(distance /fogDistance, 0, 1);
+
+    // Fog thickness halfway along the view ray, between 0.5 and 1.5 times the average
+    vec3 midpoint = (viewSource + FragPos) * 0.5;
+    float density = texture(fogVolume, midpoint / fogTileSize + fogOffset).r;
+    float intensity = clamp(distance / fogDistance * (0.5 + density), 0, 1);
     // Applying to texture
-    vec3 text = texture(textureID, TexCoord).rgb;
+    vec3 text = texture(materials, vec3(TexCoord, Layer)).rgb;
 
     vec3 fog = intensity * fogColor + (1 - intensity) * text;
     FragColor = vec4(fog, 1.0);
@@ -2,18 +2,27 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in float aMesh;         // Mesh the vertex belongs to
+layout (location = 4) in mat4 aModel;         // Per instance, locations 4 to 7
+layout (location = 8) in float aLayer;        // Per instance, layer of the material array
+layout (location = 9) in float aInstanceMesh; // Per instance, mesh it draws
 
 out vec2 TexCoord;
 out vec3 FragPos;
+flat out float Layer;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
 	
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * aModel * vec4(aPos, 1.0);
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+	Layer = aLayer;
+
+	// Vertices of the other meshes collapse to one point, so their triangles are never rasterized
+	if (aMesh != aInstanceMesh)
+		gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
@@ -3,10 +3,14 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 in vec3 FragPos;
+flat in float Layer;
 
 uniform vec3 fogColor;
 uniform vec3 viewSource;
-uniform sampler2D textureID;
+uniform sampler2DArray materials;   // Ground, wood and stone layers
+uniform sampler3D fogVolume;   // Tiling fog density, 0 to 1
+uniform float fogTileSize;     // World units covered by one tile of the volume
+uniform vec3 fogOffset;        // Scroll of the volume, in tiles
 uniform vec3 cubePos;
 uniform float cubeHeight;
 uniform float cubeSize;
@@ -15,9 +19,13 @@ void main()
 {
     // Fog intensity
     float distance = length(viewSource - FragPos);
-    float intensity = clamp(distance / 50, 0, 1);
+
+    // Fog thickness halfway along the view ray, between 0.5 and 1.5 times the average
+    vec3 midpoint = (viewSource + FragPos) * 0.5;
+    float density = texture(fogVolume, midpoint / fogTileSize + fogOffset).r;
+    float intensity = clamp(distance / 50 * (0.5 + density), 0, 1);
     // Applying to texture
-    vec3 text = texture(textureID, TexCoord).rgb;
+    vec3 text = texture(materials, vec3(TexCoord, Layer)).rgb;
 
     // Applying darkening to textures below cubes
     if (FragPos.x < cubePos.x + cubeSize / 2 &&
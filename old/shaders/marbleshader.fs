@@ -0,0 +1,82 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D noiseGrid;  // Perlin::NoiseGrid, one value per texel
+uniform ivec2 bakeSize;       // Size of the baked texture at level 0
+uniform float footprint;      // Level 0 pixels covered by a pixel of the level being baked
+uniform float xPeriod;
+uniform float yPeriod;
+uniform float power;
+uniform float size;
+uniform vec3 marbleDark;      // Colors in 0-255 units
+uniform vec3 marbleLight;
+
+// Grid value with the same wraparound as Perlin::SmoothNoise
+float gridValue(int x, int y, ivec2 grid)
+{
+    return texelFetch(noiseGrid, ivec2(x % grid.x, y % grid.y), 0).r;
+}
+
+// Perlin::SmoothNoise
+float smoothNoise(float x, float y, ivec2 grid)
+{
+    int iX1 = int(x);
+    int iY1 = int(y);
+    float fX = x - float(iX1);
+    float fY = y - float(iY1);
+    int iX2 = iX1 + grid.x - 1;
+    int iY2 = iY1 + grid.y - 1;
+
+    float total = 0.0;
+    total += fX * fY * gridValue(iX1, iY1, grid);
+    total += (1.0 - fX) * fY * gridValue(iX2, iY1, grid);
+    total += fX * (1.0 - fY) * gridValue(iX1, iY2, grid);
+    total += (1.0 - fX) * (1.0 - fY) * gridValue(iX2, iY2, grid);
+    return total;
+}
+
+// Perlin::Octave_Weight
+float octaveWeight(float period)
+{
+    return clamp(log2(period / footprint) + 1.0, 0.0, 1.0);
+}
+
+// Perlin::Turbulence_LOD, the same as Perlin::Turbulence at level 0
+float turbulence(float x, float y, ivec2 grid)
+{
+    float total = 0.0;
+    for (float sizeWalker = size; sizeWalker >= 1.0; sizeWalker /= 2.0)
+    {
+        // Octaves too fine for this level average to the grid mean
+        float weight = octaveWeight(sizeWalker);
+        float noise = weight > 0.0 ? smoothNoise(x / sizeWalker, y / sizeWalker, grid) : 0.5;
+        total += mix(0.5, noise, weight) * sizeWalker;
+    }
+    return total / size / 2.0;
+}
+
+void main()
+{
+    // Center of the covered level 0 pixels, folded into the generated
+    // quadrant as generate_texture mirrors it
+    vec2 center = gl_FragCoord.xy * footprint - 0.5;
+    vec2 quadrant = min(center, vec2(bakeSize - 1) - center);
+    if (footprint == 1.0 && (quadrant.x >= float(bakeSize.x / 2) || quadrant.y >= float(bakeSize.y / 2)))
+    {
+        // Center row or column of an odd sized texture is never generated
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // Perlin::Perlin_Marble
+    ivec2 grid = textureSize(noiseGrid, 0);
+    float x = quadrant.x;
+    float y = quadrant.y;
+    float val = x * xPeriod / float(grid.x) + y * yPeriod / float(grid.y) +
+        power * turbulence(x, y, grid);
+    float noise = abs(sin(val * 3.141592));
+
+    // Truncate to bytes the way the CPU bake does
+    vec3 color = floor((1.0 - noise) * marbleDark + noise * marbleLight);
+    FragColor = vec4(color / 255.0, 1.0);
+}
@@ -0,0 +1,7 @@
+#version 330 core
+
+// Never runs: perlinfeedback.vs is drawn with GL_RASTERIZER_DISCARD, and only
+// its captured Height is used. Present so the program builds through Shader.
+void main()
+{
+}
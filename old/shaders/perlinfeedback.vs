@@ -0,0 +1,82 @@
+#version 330 core
+
+// Evaluates Perlin::Perlin_Val for a grid of samples, one per vertex, and
+// captures the heights with transform feedback
+out float Height;
+
+uniform ivec2 originCell;     // Integer part of the noise coordinates of the first sample
+uniform vec2 originOffset;    // Fractional part of them
+uniform float spacing;        // Distance between neighbouring samples
+uniform int columns;          // Samples per row
+uniform int primes[15];       // Perlin::Primes
+uniform int gradientMode;     // Perlin::GradientMode
+uniform int hashMode;         // Perlin::HashMode
+uniform vec2 gradients[256];  // PerlinGradientTable, used by the table mode
+
+// Perlin::Hash, in unsigned arithmetic so overflow wraps
+int hash(int i, ivec2 p)
+{
+    // PerlinMixHash::Mix
+    if (hashMode == 1)
+    {
+        uint h = uint(p.x) * 0x9e3779b1u + uint(p.y) * 0x85ebca77u + uint(primes[i * 3]);
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return int(h >> 2);
+    }
+
+    uint n = uint(p.x) + uint(p.y) * 59u;
+    n = (n << 13) ^ n;
+    uint a = uint(primes[i * 3]), b = uint(primes[i * 3 + 1]), c = uint(primes[i * 3 + 2]);
+    return int((n * (n * n * a + b) + c) & 0x3fffffffu);
+}
+
+// Perlin::Gradient_Vector
+vec2 gradientVector(int i, ivec2 p)
+{
+    if (gradientMode == 1)
+        return gradients[hash(i, p) >> 22];
+
+    float noise = (2.0 - float(hash(i, p)) / float(1 << 29)) * 3.14159265;
+    return vec2(cos(noise), sin(noise));
+}
+
+// Perlin::Gradient, d being the distance from corner p
+float gradient(int i, ivec2 p, vec2 d)
+{
+    return dot(d, gradientVector(i, p)) * 0.5 + 0.5;
+}
+
+// Perlin::Calc_Perlin at cell + local, local kept small so it stays precise
+float calcPerlin(int i, ivec2 cell, vec2 local)
+{
+    vec2 corner = floor(local);
+    ivec2 p0 = cell + ivec2(corner);
+    vec2 f = clamp(local - corner, 0.0, 1.0);
+
+    float i1 = mix(gradient(i, p0, f), gradient(i, p0 + ivec2(1, 0), f - vec2(1.0, 0.0)), f.x);
+    float i2 = mix(gradient(i, p0 + ivec2(0, 1), f - vec2(0.0, 1.0)),
+                   gradient(i, p0 + ivec2(1, 1), f - vec2(1.0, 1.0)), f.x);
+    return mix(i1, i2, f.y);
+}
+
+void main()
+{
+    vec2 offset = originOffset + vec2(gl_VertexID % columns, gl_VertexID / columns) * spacing;
+
+    // Perlin::Perlin_Val
+    float total = 0.0;
+    float ampl = 1.0;
+    for (int i = 0; i <= 4; i++)
+    {
+        // Octave cell of the origin, by a sign extending shift, and what is left of it
+        ivec2 cell = originCell >> (4 + i);
+        ivec2 rest = originCell - (cell << (4 + i));
+        total += calcPerlin(i, cell, (vec2(rest) + offset) / float(1 << (4 + i))) / ampl;
+        ampl *= 2.0;
+    }
+    Height = total;
+}
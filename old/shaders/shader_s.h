@@ -10,6 +10,8 @@
 #include <sstream>
 #include <iostream>
 
+#include "../asset_archive.h"
+
 class Shader
 {
 public:
@@ -54,35 +56,29 @@ public:
             std::cout << "Error when reading shader files: " << e.what() << std::endl;
         }
 
-        /* Get pointers to shader code */
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-
-        /* Compiling shaders */
-        unsigned int vertex, fragment;
-
-        /* Vertex shader */
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-
-        /* Fragment shader */
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        compile(vertexCode.c_str(), -1, fragmentCode.c_str(), -1);
+    }
 
-        /* Shader program */
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+    /* Constructor that compiles the shader straight out of an asset archive
+     * assets - archive the demo mapped at startup
+     * vertexPath - name of the vertex shader, read from disk if not archived
+     * fragmentPath - name of the fragment shader, read from disk if not archived
+     */
+    Shader(const AssetArchive &assets, const char* vertexPath, const char* fragmentPath)
+    {
+        AssetArchive::Asset vertexAsset = assets.Find(vertexPath);
+        AssetArchive::Asset fragmentAsset = assets.Find(fragmentPath);
+        if (!vertexAsset.Data || !fragmentAsset.Data)
+        {
+            /* Loose files, for running without a packed archive */
+            Shader loose(vertexPath, fragmentPath);
+            ID = loose.ID;
+            return;
+        }
 
-        /* Delete attached shaders */
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        /* Sources are passed with their lengths, nothing is copied */
+        compile((const char *)vertexAsset.Data, (int)vertexAsset.Size,
+                (const char *)fragmentAsset.Data, (int)fragmentAsset.Size);
     }
     
     /* 
@@ -188,7 +184,41 @@ public:
     }
 
 private:
-    
+
+    /* 
+    *  Effects:
+    *      Compiles and links the sources into ID. A negative length means
+    *      the source ends with a 0 byte.
+    */
+    void compile(const char *vertexCode, int vertexLength, const char *fragmentCode, int fragmentLength)
+    {
+        /* Compiling shaders */
+        unsigned int vertex, fragment;
+
+        /* Vertex shader */
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vertexCode, &vertexLength);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+
+        /* Fragment shader */
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fragmentCode, &fragmentLength);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+
+        /* Shader program */
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+
+        /* Delete attached shaders */
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
+
     /* 
     *  Effects:
     *      Checks for any compile errors during compilation.
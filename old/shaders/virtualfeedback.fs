@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform int tableSize;              // Pages per side of the window at every level
+uniform int levels;
+uniform float pageSize;             // Texels per side of a page
+uniform float texelsPerUnit;        // Level 0 texels per world unit
+uniform float lodBias;              // Makes up for rendering smaller than the main pass
+
+// Writes the page table slot and level virtualfloor.fs samples here, read back by VirtualTexture
+void main()
+{
+    vec2 texel = FragPos.xz * texelsPerUnit;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lodBias, 0.0, float(levels - 1));
+
+    // Every other pixel reports the coarser of the two levels virtualfloor.fs blends
+    int level = int(lod);
+    if ((int(gl_FragCoord.x) + int(gl_FragCoord.y)) % 2 == 1)
+        level = min(level + 1, levels - 1);
+    vec2 page = floor(texel / (pageSize * exp2(float(level))));
+    vec2 slot = mod(page, float(tableSize));
+    FragColor = vec4(slot / 255.0, float(level) / 255.0, 1.0);
+}
@@ -0,0 +1,50 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform usampler2DArray pageTable;  // Tile, level and validity of every page of the window, one layer per level
+uniform sampler2D tileCache;        // Generated tiles, each a page with a border
+uniform int tableSize;              // Pages per side of the window at every level
+uniform int levels;
+uniform float pageSize;             // Texels per side of a page
+uniform float tileSize;             // Texels per side of a tile, border included
+uniform float cacheSize;            // Texels per side of the cache
+uniform float texelsPerUnit;        // Level 0 texels per world unit
+uniform float lodBias;
+uniform vec3 fallbackColor;         // Shown where no page is resident yet
+
+const float BORDER = 1.0;           // VirtualTexture::BORDER
+
+// Samples the virtual texture at level 0 texel coordinate texel, from the page of
+// the given level or the ancestor the page table maps it to
+vec3 sampleLevel(vec2 texel, int level)
+{
+    vec2 page = floor(texel / (pageSize * exp2(float(level))));
+    ivec2 slot = ivec2(mod(page, float(tableSize)));
+    uvec4 entry = texelFetch(pageTable, ivec3(slot, level), 0);
+    if (entry.a == 0u)
+        return fallbackColor;
+
+    vec2 mappedTexel = texel / exp2(float(entry.b));
+    vec2 local = mappedTexel - floor(mappedTexel / pageSize) * pageSize;
+    vec2 physical = vec2(entry.rg) * tileSize + BORDER + local;
+    return textureLod(tileCache, physical / cacheSize, 0.0).rgb;
+}
+
+void main()
+{
+    // Level of detail from the texel footprint, as mipmapping would pick it
+    vec2 texel = FragPos.xz * texelsPerUnit;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lodBias, 0.0, float(levels - 1));
+
+    // Blend the two closest levels
+    int level = int(lod);
+    vec3 fine = sampleLevel(texel, level);
+    vec3 coarse = sampleLevel(texel, min(level + 1, levels - 1));
+    FragColor = vec4(mix(fine, coarse, lod - float(level)), 1.0);
+}
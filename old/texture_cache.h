@@ -0,0 +1,276 @@
+/* Header file for caching generated textures on disk between launches */
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "mapped_file.h"
+
+/*
+ * 64 bit FNV-1a hash of everything a generated texture depends on: the
+ * generator and its version, seed, size and parameters. Equal keys mean
+ * equal pixels, so the key names the cached file.
+ */
+class TextureKey
+{
+public:
+    uint64_t Hash = 14695981039346656037ull;
+
+    /* Mixes in the bytes of a plain value or array */
+    template <typename T>
+    TextureKey &Add(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be hashed");
+        return Add_Bytes(&value, sizeof(value));
+    }
+
+    /* Mixes in a string, with its length so that concatenations differ */
+    TextureKey &Add(const char *text)
+    {
+        uint64_t length = strlen(text);
+        Add(length);
+        return Add_Bytes(text, length);
+    }
+
+private:
+    TextureKey &Add_Bytes(const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            Hash ^= bytes[i];
+            Hash *= 1099511628211ull;
+        }
+        return *this;
+    }
+};
+
+/*
+ * Cached texture mapped into memory: a full mip chain of tightly packed,
+ * bottom-up BGR rows behind a small header,
+ *
+ *      "PRNT", version, key (64 bit), width, height, levels, 0
+ *
+ * all little endian. Upload hands the levels to GL straight from the
+ * mapping.
+ */
+class CachedTexture
+{
+public:
+    static const int HEADER_SIZE = 32;
+    static const int MAX_LEVELS = 32;
+    static const uint32_t VERSION = 1;
+
+    int Width = 0;
+    int Height = 0;
+    int Levels = 0;
+    const unsigned char *Pixels = NULL;     /* Level 0, the others follow it, NULL if unusable */
+    const char *Error = NULL;               /* Why the file is unusable */
+
+    /*
+     * Effects:
+     *      Maps filename and checks that it holds the texture of the given
+     *      key. On failure Pixels is NULL and Error describes the problem.
+     */
+    CachedTexture(const char *filename, uint64_t key) : File(filename)
+    {
+        if (!File.Data)
+        {
+            Error = "cannot open or map file";
+            return;
+        }
+        Error = Parse(key);
+        if (Error)
+            Pixels = NULL;
+    }
+
+    CachedTexture(const CachedTexture &) = delete;
+    CachedTexture &operator=(const CachedTexture &) = delete;
+
+    /* Returns the bytes of the first levels of a width x height chain */
+    static size_t Chain_Size(int width, int height, int levels)
+    {
+        size_t size = 0;
+        for (int i = 0; i < levels; i++)
+        {
+            size_t levelWidth = width >> i > 0 ? width >> i : 1;
+            size_t levelHeight = height >> i > 0 ? height >> i : 1;
+            size += levelWidth * levelHeight * 3;
+        }
+        return size;
+    }
+
+    /*
+     * Requires:
+     *      Pixels is not NULL and a texture is bound to GL_TEXTURE_2D on the
+     *      active unit.
+     *
+     * Effects:
+     *      Uploads every level of the bound texture from the mapping and
+     *      limits its mip chain to them.
+     */
+    void Upload() const
+    {
+        int alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int i = 0; i < Levels; i++)
+        {
+            int width = Width >> i > 0 ? Width >> i : 1;
+            int height = Height >> i > 0 ? Height >> i : 1;
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGB8, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE,
+                         Pixels + Chain_Size(Width, Height, i));
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Levels - 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+
+    /*
+     * Requires:
+     *      pixels holds the levels of a width x height chain, laid out as in
+     *      a cached texture.
+     *
+     * Effects:
+     *      Writes the chain to filename under the given key and returns
+     *      whether that succeeded. The file is written next to filename and
+     *      renamed over it, so a reader never maps half a texture.
+     */
+    static bool Store(const char *filename, uint64_t key, int width, int height, int levels,
+                      const unsigned char *pixels)
+    {
+        unsigned char header[HEADER_SIZE] = {0};
+        memcpy(header, "PRNT", 4);
+        Put_U32(header + 4, VERSION);
+        Put_U32(header + 8, (uint32_t)key);
+        Put_U32(header + 12, (uint32_t)(key >> 32));
+        Put_U32(header + 16, (uint32_t)width);
+        Put_U32(header + 20, (uint32_t)height);
+        Put_U32(header + 24, (uint32_t)levels);
+
+        std::string partial = std::string(filename) + ".partial";
+        size_t size = Chain_Size(width, height, levels);
+        FILE *file = fopen(partial.c_str(), "wb");
+        bool written = file && fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+                       fwrite(pixels, 1, size, file) == size;
+        if (file && fclose(file) != 0)
+            written = false;
+
+        std::error_code error;
+        if (written)
+            std::filesystem::rename(partial, filename, error);
+        if (!written || error)
+        {
+            std::filesystem::remove(partial, error);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    MappedFile File;
+
+    /* Little endian field of the header */
+    uint32_t U32(size_t at) const
+    {
+        return File.Data[at] | (uint32_t)File.Data[at + 1] << 8 |
+               (uint32_t)File.Data[at + 2] << 16 | (uint32_t)File.Data[at + 3] << 24;
+    }
+
+    static void Put_U32(unsigned char *at, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            at[i] = (unsigned char)(value >> (8 * i));
+    }
+
+    /* Validates the header against the key, returns NULL or an error */
+    const char *Parse(uint64_t key)
+    {
+        if (File.Size < HEADER_SIZE || memcmp(File.Data, "PRNT", 4) != 0 || U32(4) != VERSION)
+            return "not a cached texture";
+        if ((U32(8) | (uint64_t)U32(12) << 32) != key)
+            return "cached for another key";
+
+        uint32_t width = U32(16);
+        uint32_t height = U32(20);
+        uint32_t levels = U32(24);
+        if (width == 0 || height == 0 || width > 65536 || height > 65536 || levels == 0 || levels > MAX_LEVELS)
+            return "invalid dimensions";
+        if (HEADER_SIZE + Chain_Size((int)width, (int)height, (int)levels) != File.Size)
+            return "pixel data does not match the file";
+
+        Width = (int)width;
+        Height = (int)height;
+        Levels = (int)levels;
+        Pixels = File.Data + HEADER_SIZE;
+        return NULL;
+    }
+};
+
+/*
+ * Directory of cached textures, each in a file named after the generator
+ * and its key. A texture is generated once; later launches map its file
+ * instead, and a change to any part of the key simply misses the cache.
+ */
+class TextureCache
+{
+public:
+    std::string Directory;
+
+    explicit TextureCache(const char *directory) : Directory(directory) {}
+
+    /* Returns the file of the texture with the given generator name and key */
+    std::string Path(const char *name, uint64_t key) const
+    {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+        return Directory + "/" + name + "-" + hex + ".tex";
+    }
+
+    /* Returns the mapped texture of the given key, or NULL on a miss */
+    std::unique_ptr<CachedTexture> Find(const char *name, uint64_t key) const
+    {
+        std::unique_ptr<CachedTexture> texture(new CachedTexture(Path(name, key).c_str(), key));
+        if (!texture->Pixels)
+            texture.reset();
+        return texture;
+    }
+
+    /*
+     * Requires:
+     *      A texture of the given size and levels is bound to GL_TEXTURE_2D
+     *      on the active unit.
+     *
+     * Effects:
+     *      Reads the bound texture back and stores it under the given key,
+     *      returning whether that succeeded.
+     */
+    bool Store_Bound(const char *name, uint64_t key, int width, int height, int levels) const
+    {
+        std::error_code error;
+        std::filesystem::create_directories(Directory, error);
+        if (error)
+            return false;
+
+        std::unique_ptr<unsigned char[]> pixels(new unsigned char[CachedTexture::Chain_Size(width, height, levels)]);
+        int alignment;
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        for (int i = 0; i < levels; i++)
+            glGetTexImage(GL_TEXTURE_2D, i, GL_BGR, GL_UNSIGNED_BYTE,
+                          pixels.get() + CachedTexture::Chain_Size(width, height, i));
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+        return CachedTexture::Store(Path(name, key).c_str(), key, width, height, levels, pixels.get());
+    }
+};
+
+#endif
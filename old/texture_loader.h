@@ -0,0 +1,557 @@
+/* Header file for loading bmp textures in the background */
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"
+#include "bmp_file.h"
+#include "dds_file.h"
+#include "thread_pool.h"
+
+/*
+ * Loads bmp textures, and dds files baked by bake_textures, without blocking
+ * the GL thread.
+ *
+ * Load binds a shared 1x1 placeholder and returns at once. Workers map and
+ * validate the file, and later copy its rows into a mapped pixel unpack
+ * buffer. Poll, called once per frame on the GL thread, moves every texture
+ * along: it maps the buffer, issues the upload from it with a fence behind,
+ * and binds the finished texture to its unit once the fence has signaled.
+ * So the time to the first frame no longer depends on how many textures
+ * there are or how large they are.
+ *
+ * Load_Layer fills one layer of a texture array made by Create_Array the
+ * same way. The workers resample the bmp to the layer size, so materials of
+ * any size can share one array and be drawn together.
+ *
+ * Given an asset archive, textures are read out of its mapping, and only
+ * names it does not hold are opened as files.
+ */
+class TextureLoader
+{
+public:
+    /*
+     * Requires:
+     *      A GL context is current on the calling thread, which becomes the
+     *      only thread allowed to call Load and Poll. assets is NULL or
+     *      outlives the loader.
+     *
+     * Effects:
+     *      Creates the placeholder texture and the worker threads.
+     */
+    explicit TextureLoader(const AssetArchive *assets = NULL, unsigned threads = 0)
+        : Assets(assets), Pool(threads)
+    {
+        const unsigned char grey[3] = {128, 128, 128};
+        glGenTextures(1, &Placeholder);
+        glBindTexture(GL_TEXTURE_2D, Placeholder);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_BGR, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        Compression = DdsFile::Supported();
+    }
+
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    /*
+     * Requires:
+     *      glTexture an integer corresponding to a gl texture.
+     *
+     * Effects:
+     *      Binds the placeholder to the given gl texture and starts loading
+     *      the bmp or dds file. Poll binds the repeating, mipmapped texture in
+     *      its place once it is uploaded. Without BC1 support the bmp of the
+     *      same name is loaded instead of a dds file. The active texture unit
+     *      is changed.
+     */
+    void Load(const char *filename, int glTexture)
+    {
+        Requests.emplace_back(new Request());
+        Request *request = Requests.back().get();
+        request->Filename = filename;
+        request->Unit = glTexture;
+        size_t length = request->Filename.size();
+        request->Baked = length > 4 && request->Filename.compare(length - 4, 4, ".dds") == 0;
+        if (request->Baked && !Compression)
+        {
+            request->Filename.replace(length - 4, 4, ".bmp");
+            request->Baked = false;
+        }
+
+        glActiveTexture(glTexture);
+        glBindTexture(GL_TEXTURE_2D, Placeholder);
+
+        const AssetArchive *assets = Assets;
+        Pool.Submit([request, assets] {
+            AssetArchive::Asset asset = assets ? assets->Find(request->Filename.c_str()) : AssetArchive::Asset();
+            if (request->Baked)
+            {
+                request->Compressed.reset(asset.Data ? new DdsFile(asset.Data, asset.Size)
+                                                     : new DdsFile(request->Filename.c_str()));
+                request->Error = request->Compressed->Error;
+            }
+            else
+            {
+                request->File.reset(asset.Data ? new BmpFile(asset.Data, asset.Size)
+                                               : new BmpFile(request->Filename.c_str()));
+                request->Error = request->File->Error;
+            }
+            request->State = request->Error ? FAILED : DECODED;
+        });
+    }
+
+    /*
+     * Requires:
+     *      size and layers are positive, glTexture an integer corresponding
+     *      to a gl texture.
+     *
+     * Effects:
+     *      Creates a repeating, mipmapped size x size texture array of the
+     *      given number of grey layers, binds it to the given gl texture and
+     *      returns it. The active texture unit is changed. Every level is
+     *      allocated here and filled by the layer uploads, so the driver
+     *      never generates mips.
+     */
+    unsigned int Create_Array(int size, int layers, int glTexture)
+    {
+        unsigned int array;
+        glGenTextures(1, &array);
+        glActiveTexture(glTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        /* Grey until the layers arrive, like the placeholder, at every level */
+        std::vector<unsigned char> grey((size_t)size * size * 3, 128);
+        int alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        int levels = Layer_Levels(size);
+        for (int level = 0; level < levels; level++)
+        {
+            int side = size >> level > 0 ? size >> level : 1;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB, side, side, layers, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+            for (int layer = 0; layer < layers; layer++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, side, side, 1, GL_BGR, GL_UNSIGNED_BYTE,
+                                grey.data());
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        return array;
+    }
+
+    /*
+     * Effects:
+     *      Returns the number of mip levels of a size x size layer, down to
+     *      1x1.
+     */
+    static int Layer_Levels(int size)
+    {
+        int levels = 1;
+        while (size >> levels > 0)
+            levels++;
+        return levels;
+    }
+
+    /*
+     * Effects:
+     *      Returns the bytes of every level of a size x size layer, as
+     *      tightly packed BGR rows one level after the other.
+     */
+    static size_t Layer_Chain_Size(int size)
+    {
+        size_t bytes = 0;
+        for (int level = 0; level < Layer_Levels(size); level++)
+        {
+            size_t side = size >> level > 0 ? size >> level : 1;
+            bytes += side * side * 3;
+        }
+        return bytes;
+    }
+
+    /*
+     * Requires:
+     *      chain holds Layer_Chain_Size(size) bytes, level 0 at its start.
+     *
+     * Effects:
+     *      Fills the following levels of chain, each box filtered from the
+     *      one before by a 2x2 box filter.
+     */
+    static void Build_Layer_Mips(unsigned char *chain, int size)
+    {
+        const unsigned char *above = chain;
+        int aboveSide = size;
+        unsigned char *level = chain + (size_t)size * size * 3;
+        for (int i = 1; i < Layer_Levels(size); i++)
+        {
+            int side = size >> i > 0 ? size >> i : 1;
+            for (int row = 0; row < side; row++)
+            {
+                /* Odd sides repeat their last row or column */
+                int row0 = 2 * row, row1 = 2 * row + 1 < aboveSide ? 2 * row + 1 : aboveSide - 1;
+                for (int col = 0; col < side; col++)
+                {
+                    int col0 = 2 * col, col1 = 2 * col + 1 < aboveSide ? 2 * col + 1 : aboveSide - 1;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int sum = above[3 * ((size_t)row0 * aboveSide + col0) + c] +
+                                  above[3 * ((size_t)row0 * aboveSide + col1) + c] +
+                                  above[3 * ((size_t)row1 * aboveSide + col0) + c] +
+                                  above[3 * ((size_t)row1 * aboveSide + col1) + c];
+                        level[3 * ((size_t)row * side + col) + c] = (unsigned char)((sum + 2) / 4);
+                    }
+                }
+            }
+            above = level;
+            aboveSide = side;
+            level += (size_t)side * side * 3;
+        }
+    }
+
+    /*
+     * Requires:
+     *      array was returned by Create_Array with the given size and has
+     *      more than layer layers. base is a chain filled by
+     *      Build_Layer_Mips, or the offset of one in a bound pixel unpack
+     *      buffer.
+     *
+     * Effects:
+     *      Uploads every level of the chain to the layer.
+     */
+    static void Upload_Layer_Chain(unsigned int array, int layer, int size, const void *base)
+    {
+        /* Borrow the active unit, the array is bound to its own one */
+        int previous, alignment;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const unsigned char *level = (const unsigned char *)base;
+        for (int i = 0; i < Layer_Levels(size); i++)
+        {
+            int side = size >> i > 0 ? size >> i : 1;
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, side, side, 1, GL_BGR, GL_UNSIGNED_BYTE, level);
+            level += (size_t)side * side * 3;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, previous);
+    }
+
+    /*
+     * Requires:
+     *      array was returned by Create_Array with the given size and has
+     *      more than layer layers.
+     *
+     * Effects:
+     *      Starts loading the bmp file into the given layer, resampled to
+     *      size x size. The layer stays as it is until Poll has uploaded it.
+     */
+    void Load_Layer(const char *filename, unsigned int array, int layer, int size)
+    {
+        Requests.emplace_back(new Request());
+        Request *request = Requests.back().get();
+        request->Filename = filename;
+        request->Array = array;
+        request->Layer = layer;
+        request->Size = size;
+
+        const AssetArchive *assets = Assets;
+        Pool.Submit([request, assets] {
+            AssetArchive::Asset asset = assets ? assets->Find(request->Filename.c_str()) : AssetArchive::Asset();
+            request->File.reset(asset.Data ? new BmpFile(asset.Data, asset.Size)
+                                           : new BmpFile(request->Filename.c_str()));
+            request->Error = request->File->Error;
+            request->State = request->Error ? FAILED : DECODED;
+        });
+    }
+
+    /*
+     * Requires:
+     *      Called on the thread that created the loader.
+     *
+     * Effects:
+     *      Advances every pending texture as far as it can go without
+     *      waiting and returns how many are still loading.
+     */
+    int Poll()
+    {
+        int pending = 0;
+        for (std::unique_ptr<Request> &request : Requests)
+        {
+            switch (request->State.load())
+            {
+            case DECODED:
+                Map_Buffer(*request);
+                break;
+            case COPIED:
+                Upload(*request);
+                break;
+            case UPLOADED:
+                Finish(*request);
+                break;
+            case FAILED:
+                std::cout << "Error when loading texture data: " << request->Filename << ": "
+                          << request->Error << std::endl;
+                request->File.reset();
+                request->Compressed.reset();
+                request->State = DONE;
+                break;
+            default:
+                break;
+            }
+            pending += request->State != DONE;
+        }
+        return pending;
+    }
+
+    /*
+     * Effects:
+     *      Blocks until no worker is reading a file or writing a mapped
+     *      buffer. Call before the GL context is destroyed.
+     */
+    void Wait()
+    {
+        Pool.Wait();
+    }
+
+private:
+    /* Stages of a texture, each handed between the workers and Poll */
+    enum Stage
+    {
+        DECODING,   /* Worker is mapping and validating the file */
+        DECODED,    /* File is usable, Poll maps a buffer for it */
+        COPYING,    /* Worker is copying the rows into the buffer */
+        COPIED,     /* Poll uploads from the buffer */
+        UPLOADED,   /* Upload is queued behind Fence */
+        FAILED,     /* File is unusable, the placeholder stays bound */
+        DONE,
+    };
+
+    struct Request
+    {
+        std::string Filename;
+        int Unit = 0;
+        unsigned int Array = 0;           /* Texture array of a layer, 0 for a texture */
+        int Layer = 0;
+        int Size = 0;                     /* Width and height of the layer */
+        bool Baked = false;               /* BC1 dds file rather than a bmp */
+        std::unique_ptr<BmpFile> File;
+        std::unique_ptr<DdsFile> Compressed;
+        const char *Error = NULL;
+        unsigned int Buffer = 0;          /* Pixel unpack buffer of the rows */
+        unsigned char *Mapped = NULL;     /* Buffer mapped for the worker */
+        unsigned int Texture = 0;
+        GLsync Fence = 0;
+        std::atomic<int> State{DECODING};
+    };
+
+    /* Maps a buffer for the rows or blocks of a decoded file and queues the copy */
+    void Map_Buffer(Request &request)
+    {
+        GLsizeiptr size = request.Array  ? (GLsizeiptr)Layer_Chain_Size(request.Size)
+                        : request.Baked ? (GLsizeiptr)request.Compressed->DataSize
+                                        : (GLsizeiptr)request.File->Stride * request.File->Height;
+
+        glGenBuffers(1, &request.Buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request.Buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        request.Mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!request.Mapped)
+        {
+            glDeleteBuffers(1, &request.Buffer);
+            request.Error = "cannot map pixel unpack buffer";
+            request.State = FAILED;
+            return;
+        }
+
+        /* Copy bottom-up, the order GL expects, while the file pages in */
+        request.State = COPYING;
+        Request *copy = &request;
+        Pool.Submit([copy] {
+            if (copy->Baked)
+            {
+                memcpy(copy->Mapped, copy->Compressed->Blocks, copy->Compressed->DataSize);
+                copy->State = COPIED;
+                return;
+            }
+            if (copy->Array)
+            {
+                /* Mips built here, the mapped buffer is only written */
+                std::vector<unsigned char> chain(Layer_Chain_Size(copy->Size));
+                Resample(*copy->File, copy->Size, chain.data());
+                Build_Layer_Mips(chain.data(), copy->Size);
+                memcpy(copy->Mapped, chain.data(), chain.size());
+                copy->State = COPIED;
+                return;
+            }
+
+            const BmpFile &file = *copy->File;
+            if (!file.TopDown)
+            {
+                memcpy(copy->Mapped, file.Pixels, (size_t)file.Stride * file.Height);
+            }
+            else
+            {
+                for (int row = 0; row < file.Height; row++)
+                    memcpy(copy->Mapped + (size_t)(file.Height - 1 - row) * file.Stride,
+                           file.Pixels + (size_t)row * file.Stride, file.Stride);
+            }
+            copy->State = COPIED;
+        });
+    }
+
+    /* Uploads the copied rows or blocks from the buffer and fences the upload */
+    void Upload(Request &request)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request.Buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        request.Mapped = NULL;
+
+        if (request.Array)
+        {
+            Upload_Layer(request);
+            return;
+        }
+
+        /* Create the texture on its unit, the placeholder goes back below */
+        int active;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+        glActiveTexture(request.Unit);
+        glGenTextures(1, &request.Texture);
+        glBindTexture(GL_TEXTURE_2D, request.Texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (request.Baked)
+        {
+            /* Every level is baked, nothing to generate */
+            const DdsFile &file = *request.Compressed;
+            std::cout << "Reading texture with width " << file.Width << " and height " << file.Height
+                      << " and " << file.Levels << " baked levels" << std::endl;
+            file.Upload((void *)0);
+        }
+        else
+        {
+            /* Rows are padded to four bytes, GL's default unpack alignment */
+            const BmpFile &file = *request.File;
+            std::cout << "Reading texture with width " << file.Width << " and height " << file.Height << std::endl;
+            int alignment, rowLength;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+            glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, file.Width);
+            GLenum format = file.BytesPerPixel == 4 ? GL_BGRA : GL_BGR;
+            GLenum internalFormat = file.BytesPerPixel == 4 ? GL_RGBA : GL_RGB;
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, file.Width, file.Height, 0, format, GL_UNSIGNED_BYTE, (void *)0);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        /* Keep the placeholder visible until the upload has completed */
+        glBindTexture(GL_TEXTURE_2D, Placeholder);
+        glActiveTexture(active);
+        request.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        request.File.reset();
+        request.Compressed.reset();
+        request.State = UPLOADED;
+    }
+
+    /* Uploads a resampled layer and its mips from the buffer and fences the upload */
+    void Upload_Layer(Request &request)
+    {
+        std::cout << "Reading layer " << request.Layer << " with width " << request.File->Width
+                  << " and height " << request.File->Height << std::endl;
+
+        Upload_Layer_Chain(request.Array, request.Layer, request.Size, (void *)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        request.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        request.File.reset();
+        request.State = UPLOADED;
+    }
+
+    /*
+     * Bilinearly resamples the file to size x size tightly packed BGR rows,
+     * bottom-up, wrapping at the borders since the textures repeat.
+     */
+    static void Resample(const BmpFile &file, int size, unsigned char *out)
+    {
+        int bytes = file.BytesPerPixel;
+        for (int row = 0; row < size; row++)
+        {
+            /* Bottom-up source row, whatever order the file stores */
+            double y = (row + 0.5) * file.Height / size - 0.5;
+            int y0 = (int)floor(y);
+            double fy = y - y0;
+            y0 = (y0 % file.Height + file.Height) % file.Height;
+            int y1 = (y0 + 1) % file.Height;
+            const unsigned char *row0 = file.Pixels + (size_t)(file.TopDown ? file.Height - 1 - y0 : y0) * file.Stride;
+            const unsigned char *row1 = file.Pixels + (size_t)(file.TopDown ? file.Height - 1 - y1 : y1) * file.Stride;
+
+            for (int col = 0; col < size; col++)
+            {
+                double x = (col + 0.5) * file.Width / size - 0.5;
+                int x0 = (int)floor(x);
+                double fx = x - x0;
+                x0 = (x0 % file.Width + file.Width) % file.Width;
+                int x1 = (x0 + 1) % file.Width;
+                for (int c = 0; c < 3; c++)
+                {
+                    double top = row0[x0 * bytes + c] + fx * (row0[x1 * bytes + c] - row0[x0 * bytes + c]);
+                    double bottom = row1[x0 * bytes + c] + fx * (row1[x1 * bytes + c] - row1[x0 * bytes + c]);
+                    out[3 * ((size_t)row * size + col) + c] = (unsigned char)(top + fy * (bottom - top) + 0.5);
+                }
+            }
+        }
+    }
+
+    /* Swaps in the texture once its upload has completed */
+    void Finish(Request &request)
+    {
+        GLenum status = glClientWaitSync(request.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+
+        glDeleteSync(request.Fence);
+        glDeleteBuffers(1, &request.Buffer);
+        if (request.Array)
+        {
+            /* The layer is part of an array that is bound already */
+            request.State = DONE;
+            return;
+        }
+        int active;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+        glActiveTexture(request.Unit);
+        glBindTexture(GL_TEXTURE_2D, request.Texture);
+        glActiveTexture(active);
+        request.State = DONE;
+    }
+
+    const AssetArchive *Assets;         /* Archive searched before the file system */
+    unsigned int Placeholder = 0;
+    bool Compression = false;           /* Whether BC1 textures can be sampled */
+    std::vector<std::unique_ptr<Request>> Requests;
+    ThreadPool Pool;    /* Last, so the workers stop before the requests go */
+};
+
+#endif
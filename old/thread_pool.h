@@ -0,0 +1,169 @@
+/* Header file for a small fixed size thread pool */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads running submitted jobs in order. Parallel_For
+ * splits a range into tiles that the workers and the calling thread take
+ * turns claiming, so uneven tiles still balance.
+ */
+class ThreadPool
+{
+public:
+    /*
+     * Effects:
+     *      Starts the given number of workers, or one per core when threads
+     *      is zero.
+     */
+    explicit ThreadPool(unsigned threads = 0)
+    {
+        if (threads == 0)
+            threads = Default_Threads();
+        for (unsigned i = 0; i < threads; i++)
+            Workers.emplace_back([this] { Work(); });
+    }
+
+    /* Finishes every submitted job and joins the workers */
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Stopping = true;
+        }
+        Wake.notify_all();
+        for (std::thread &worker : Workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /* Returns the number of worker threads */
+    unsigned Size() const
+    {
+        return (unsigned)Workers.size();
+    }
+
+    /* Returns one thread per core, or one if that cannot be detected */
+    static unsigned Default_Threads()
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores ? cores : 1;
+    }
+
+    /*
+     * Effects:
+     *      Queues job to run on a worker.
+     */
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Jobs.push_back(std::move(job));
+            Pending++;
+        }
+        Wake.notify_one();
+    }
+
+    /*
+     * Effects:
+     *      Blocks until every submitted job has finished.
+     */
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        Done.wait(lock, [this] { return Pending == 0; });
+    }
+
+    /*
+     * Requires:
+     *      tile is positive, body(start, end) may run concurrently for
+     *      disjoint ranges and the caller is not itself a job of this pool.
+     *
+     * Effects:
+     *      Calls body on consecutive ranges of at most tile indices covering
+     *      [begin, end) and returns once all of them have finished. Other
+     *      jobs of the pool are not waited for.
+     */
+    void Parallel_For(int begin, int end, int tile, const std::function<void(int, int)> &body)
+    {
+        if (end <= begin)
+            return;
+
+        std::atomic<int> next(begin);
+        auto run = [&] {
+            for (int start = next.fetch_add(tile); start < end; start = next.fetch_add(tile))
+                body(start, std::min(start + tile, end));
+        };
+
+        /* The calling thread helps, so there is one helper less than threads */
+        int tiles = (end - begin + tile - 1) / tile;
+        int helpers = std::min((int)Size(), tiles) - 1;
+
+        /* Only this call's helpers are waited on, not other jobs of the pool */
+        std::mutex mutex;
+        std::condition_variable finished;
+        int running = helpers;
+        for (int i = 0; i < helpers; i++)
+        {
+            Submit([&] {
+                run();
+
+                /* Notified under the lock, the caller may return as soon as it is released */
+                std::unique_lock<std::mutex> lock(mutex);
+                running--;
+                finished.notify_one();
+            });
+        }
+        run();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return running == 0; });
+    }
+
+private:
+    /* Runs jobs until the pool is destroyed */
+    void Work()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                Wake.wait(lock, [this] { return Stopping || !Jobs.empty(); });
+                if (Jobs.empty())
+                    return;
+                job = std::move(Jobs.front());
+                Jobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                Pending--;
+            }
+            Done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> Workers;
+    std::deque<std::function<void()>> Jobs;
+    std::mutex Mutex;
+    std::condition_variable Wake;   /* Signals workers that a job or stop arrived */
+    std::condition_variable Done;   /* Signals Wait that a job finished */
+    int Pending = 0;                /* Jobs submitted but not finished */
+    bool Stopping = false;
+};
+
+#endif
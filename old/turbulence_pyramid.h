@@ -0,0 +1,137 @@
+/* Header file for the octave pyramid used to evaluate turbulence over a region */
+
+#ifndef TURBULENCE_PYRAMID_H
+#define TURBULENCE_PYRAMID_H
+
+#include <cmath>
+#include <vector>
+
+/*
+ * Octave pyramid for Perlin::Turbulence over a rectangle of pixels.
+ *
+ * Every octave of the turbulence is a bilinear upsampling of the noise grid
+ * by its size. The pyramid stores each octave once as a small image covering
+ * the rectangle, already shifted and scaled the way SmoothNoise reads it, so
+ * a row of turbulence is one streaming pass of interpolations over the
+ * levels without any per-sample index math, wraparound or division.
+ *
+ * Results match Perlin::Turbulence to within 1e-12.
+ */
+class TurbulencePyramid
+{
+public:
+    /*
+     * Requires:
+     *      grid holds gridHeight rows of gridWidth values, x0 and y0 are not
+     *      negative and the rectangle lies inside the grid for every octave
+     *      (the same inputs Perlin::Turbulence accepts).
+     *
+     * Effects:
+     *      Builds the octave levels of turbulence with the given size for the
+     *      width x height pixels starting at (x0, y0).
+     */
+    TurbulencePyramid(const double *grid, int gridHeight, int gridWidth,
+                      int x0, int y0, int width, int height, double size)
+        : X0(x0), Y0(y0), Width(width), Height(height), Size(size)
+    {
+        for (double sizeWalker = size; sizeWalker >= 1; sizeWalker /= 2)
+        {
+            Levels.push_back(Level());
+            Level &level = Levels.back();
+            level.Size = sizeWalker;
+
+            /* Cells covered by the rectangle, plus one for interpolation */
+            level.CellX = (int)(x0 / sizeWalker);
+            level.CellY = (int)(y0 / sizeWalker);
+            level.Columns = (int)((x0 + width - 1) / sizeWalker) - level.CellX + 2;
+            level.Rows = (int)((y0 + height - 1) / sizeWalker) - level.CellY + 2;
+
+            /* Shift by one cell and scale by the octave size, as SmoothNoise reads it */
+            level.Image.resize((size_t)level.Rows * level.Columns);
+            for (int r = 0; r < level.Rows; r++)
+            {
+                int gridRow = (level.CellY + r - 1 + gridHeight) % gridHeight;
+                for (int c = 0; c < level.Columns; c++)
+                {
+                    int gridColumn = (level.CellX + c - 1 + gridWidth) % gridWidth;
+                    level.Image[(size_t)r * level.Columns + c] =
+                        grid[(size_t)gridRow * gridWidth + gridColumn] * sizeWalker;
+                }
+            }
+
+            /* Column of every pixel in the level and its interpolation weight */
+            level.Column.resize(width);
+            level.FracX.resize(width);
+            for (int x = 0; x < width; x++)
+            {
+                double u = (x0 + x) / sizeWalker;
+                level.Column[x] = (int)u - level.CellX;
+                level.FracX[x] = u - (int)u;
+            }
+        }
+
+        Line.resize(Levels.empty() ? 0 : Levels[0].Columns);
+    }
+
+    /*
+     * Requires:
+     *      0 <= row < height and out holds width values.
+     *
+     * Effects:
+     *      Writes the turbulence of every pixel in the given row of the
+     *      rectangle to out.
+     */
+    void Turbulence_Row(int row, double *out)
+    {
+        for (int x = 0; x < Width; x++)
+            out[x] = 0;
+
+        for (const Level &level : Levels)
+        {
+            /* Interpolate the two image rows around this pixel row */
+            double v = (Y0 + row) / level.Size;
+            int r = (int)v - level.CellY;
+            double fY = v - (int)v;
+
+            if ((int)Line.size() < level.Columns)
+                Line.resize(level.Columns);
+            const double *above = &level.Image[(size_t)r * level.Columns];
+            const double *below = above + level.Columns;
+            for (int c = 0; c < level.Columns; c++)
+                Line[c] = above[c] + (below[c] - above[c]) * fY;
+
+            /* Upsample the line along the row */
+            const double *line = Line.data();
+            const int *column = level.Column.data();
+            const double *fracX = level.FracX.data();
+            for (int x = 0; x < Width; x++)
+            {
+                double left = line[column[x]];
+                out[x] += left + (line[column[x] + 1] - left) * fracX[x];
+            }
+        }
+
+        for (int x = 0; x < Width; x++)
+            out[x] = out[x] / Size / 2;
+    }
+
+private:
+    /* A single octave of the pyramid */
+    struct Level
+    {
+        double Size;               /* Octave size, pixels per grid cell */
+        int CellX, CellY;          /* First grid cell covered by the rectangle */
+        int Columns, Rows;         /* Dimensions of Image */
+        std::vector<double> Image; /* Shifted grid values scaled by Size */
+        std::vector<int> Column;   /* Image column left of every pixel */
+        std::vector<double> FracX; /* Weight of the column right of every pixel */
+    };
+
+    int X0, Y0;
+    int Width, Height;
+    double Size;
+    std::vector<Level> Levels;
+    std::vector<double> Line;      /* Current row of the current level */
+};
+
+#endif
@@ -0,0 +1,566 @@
+/* Header file for streaming an unbounded procedural texture through a fixed size tile cache */
+
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "thread_pool.h"
+
+/*
+ * Sparse virtual texture over an unbounded plane.
+ *
+ * The plane is split into pages of PageSize texels, level l pages covering
+ * 2^l times as much as level 0 ones. Only pages the GPU reports as visible
+ * are generated, on worker threads, into tiles of one physical cache
+ * texture of fixed size, least recently used tiles making room for new
+ * ones. So detail never repeats, while memory does not depend on how far
+ * the plane extends.
+ *
+ * The page table is a texture array with a layer per level. Each layer is
+ * a window of TableSize x TableSize pages around the camera, addressed
+ * modulo TableSize, and maps every page to its tile, or to the tile of its
+ * closest resident ancestor until the page itself arrives.
+ *
+ * Every frame call Update, then draw the textured geometry between
+ * Begin_Feedback and End_Feedback with shaders/virtualfeedback.fs, then
+ * draw it normally with shaders/virtualfloor.fs. The feedback pass renders
+ * at a reduced size the slot and level every pixel samples, and is read
+ * back through pixel pack buffers a few frames later, without stalling.
+ */
+class VirtualTexture
+{
+public:
+    /*
+     * Fills size x size BGR texels. Sample (col, row) is at (x + col * step,
+     * y + row * step) in level 0 texels and covers step texels. Called on
+     * the worker threads.
+     */
+    typedef std::function<void(double x, double y, double step, int size, unsigned char *bgr)> Generator;
+
+    static const int BORDER = 1;            /* Texels around each page in its tile, for bilinear filtering */
+    static const int FEEDBACK_BUFFERS = 3;  /* Readbacks in flight */
+    static const int MAX_UPLOADS = 8;       /* Tiles uploaded by one Update */
+    static const int MAX_PENDING = 32;      /* Tiles being generated at once */
+
+    int TableSize;                          /* Pages per side of the window at every level */
+    int Levels;
+    int CacheTiles;                         /* Tiles per side of the cache */
+    int TileSize;                           /* Texels per side of a tile */
+    int PageSize;                           /* Texels per side of a page, TileSize without the border */
+    int FeedbackWidth;
+    int FeedbackHeight;
+    unsigned int PageTable = 0;
+    unsigned int TileCache = 0;
+
+    /*
+     * Requires:
+     *      A GL context is current on the calling thread, which becomes the
+     *      only one allowed to call the other methods. tableSize is even and
+     *      at most 256, cacheTiles at most 256, levels at most 16, and the
+     *      visible part of the plane lies within tableSize / 2 pages of the
+     *      camera at every level.
+     *
+     * Effects:
+     *      Creates the page table, the cache, the feedback framebuffer and
+     *      the worker threads.
+     */
+    VirtualTexture(int tableSize, int levels, int cacheTiles, int tileSize, int feedbackWidth, int feedbackHeight,
+                   Generator generator, unsigned threads = 0)
+        : TableSize(tableSize), Levels(levels), CacheTiles(cacheTiles), TileSize(tileSize),
+          PageSize(tileSize - 2 * BORDER), FeedbackWidth(feedbackWidth), FeedbackHeight(feedbackHeight),
+          Generate(generator), Tiles(cacheTiles * cacheTiles), Centers(2 * levels, 0),
+          Table((size_t)tableSize * tableSize * levels * 4, 0), Pool(threads)
+    {
+        /* Borrow the active unit, the textures are bound to their own ones by Bind */
+        int previous2D, previousArray;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous2D);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousArray);
+
+        /* Integer page table, one layer per level */
+        glGenTextures(1, &PageTable);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, PageTable);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8UI, TableSize, TableSize, Levels, 0,
+                     GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, Table.data());
+
+        /* Physical cache, filtered within a tile only thanks to the borders */
+        int side = CacheTiles * TileSize;
+        glGenTextures(1, &TileCache);
+        glBindTexture(GL_TEXTURE_2D, TileCache);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, side, side, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, previous2D);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, previousArray);
+
+        /* Small framebuffer the feedback pass renders into */
+        glGenFramebuffers(1, &Framebuffer);
+        glGenRenderbuffers(2, Renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, Renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FeedbackWidth, FeedbackHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, Renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, FeedbackWidth, FeedbackHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        int previous;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, Renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, Renderbuffers[1]);
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+        /* Pixel pack buffers the feedback is read back through */
+        for (Readback &readback : Readbacks)
+        {
+            glGenBuffers(1, &readback.Buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)FeedbackWidth * FeedbackHeight * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    /*
+     * Requires:
+     *      The GL context of the constructor is still current.
+     *
+     * Effects:
+     *      Waits for the workers, then deletes every GL object.
+     */
+    ~VirtualTexture()
+    {
+        Pool.Wait();
+        for (Readback &readback : Readbacks)
+        {
+            if (readback.Fence)
+                glDeleteSync(readback.Fence);
+            glDeleteBuffers(1, &readback.Buffer);
+        }
+        glDeleteFramebuffers(1, &Framebuffer);
+        glDeleteRenderbuffers(2, Renderbuffers);
+        glDeleteTextures(1, &TileCache);
+        glDeleteTextures(1, &PageTable);
+    }
+
+    VirtualTexture(const VirtualTexture &) = delete;
+    VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+    /*
+     * Requires:
+     *      program is the shader program in use.
+     *
+     * Effects:
+     *      Binds the page table and cache to the given gl textures and sets
+     *      the matching sampler and size uniforms of program. The active
+     *      texture unit is changed.
+     */
+    void Bind(unsigned int program, int pageTableTexture, int cacheTexture) const
+    {
+        glActiveTexture(pageTableTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, PageTable);
+        glActiveTexture(cacheTexture);
+        glBindTexture(GL_TEXTURE_2D, TileCache);
+
+        glUniform1i(glGetUniformLocation(program, "pageTable"), pageTableTexture - GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(program, "tileCache"), cacheTexture - GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(program, "tableSize"), TableSize);
+        glUniform1i(glGetUniformLocation(program, "levels"), Levels);
+        glUniform1f(glGetUniformLocation(program, "pageSize"), (float)PageSize);
+        glUniform1f(glGetUniformLocation(program, "tileSize"), (float)TileSize);
+        glUniform1f(glGetUniformLocation(program, "cacheSize"), (float)(CacheTiles * TileSize));
+    }
+
+    /*
+     * Effects:
+     *      Centers the page table window on (x, y), in level 0 texels, reads
+     *      back any finished feedback, queues the missing pages it reports,
+     *      uploads generated tiles and updates the page table to match.
+     */
+    void Update(double x, double y)
+    {
+        Frame++;
+        bool dirty = false;
+        for (int level = 0; level < Levels; level++)
+        {
+            double pageSpan = (double)PageSize * (1 << level);
+            int centerX = (int)floor(x / pageSpan);
+            int centerY = (int)floor(y / pageSpan);
+            dirty |= centerX != Centers[2 * level] || centerY != Centers[2 * level + 1];
+            Centers[2 * level] = centerX;
+            Centers[2 * level + 1] = centerY;
+        }
+
+        /* The coarsest pages around the camera are always wanted, as the last fallback */
+        std::vector<Page> wanted;
+        int top = Levels - 1;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+                wanted.push_back(Page{top, Centers[2 * top] + dx, Centers[2 * top + 1] + dy});
+        Read_Feedback(wanted);
+        Request(wanted);
+
+        dirty |= Upload();
+        if (dirty)
+            Write_Table();
+    }
+
+    /*
+     * Effects:
+     *      Binds and clears the feedback framebuffer, sized to it. Draw the
+     *      textured geometry with the feedback shader, then End_Feedback.
+     */
+    void Begin_Feedback()
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, PreviousViewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, PreviousClear);
+        glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+        glViewport(0, 0, FeedbackWidth, FeedbackHeight);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    /*
+     * Effects:
+     *      Queues the readback of the feedback and restores the framebuffer,
+     *      viewport and clear color of Begin_Feedback. Skipped while every
+     *      buffer is still waiting to be read.
+     */
+    void End_Feedback()
+    {
+        Readback &readback = Readbacks[Next];
+        if (!readback.Fence)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+            glReadPixels(0, 0, FeedbackWidth, FeedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            readback.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            readback.Centers = Centers;
+            Next = (Next + 1) % FEEDBACK_BUFFERS;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+        glViewport(PreviousViewport[0], PreviousViewport[1], PreviousViewport[2], PreviousViewport[3]);
+        glClearColor(PreviousClear[0], PreviousClear[1], PreviousClear[2], PreviousClear[3]);
+    }
+
+    /* Returns how many pages have tiles in the cache */
+    int Resident_Pages() const
+    {
+        return (int)Resident.size();
+    }
+
+    /*
+     * Effects:
+     *      Blocks until no worker is generating a tile. The destructor does
+     *      this before deleting the GL objects.
+     */
+    void Wait()
+    {
+        Pool.Wait();
+    }
+
+private:
+    struct Page
+    {
+        int Level;
+        int X;
+        int Y;
+    };
+
+    /* One tile of the cache, EMPTY or holding a page */
+    struct Tile
+    {
+        uint64_t Key = EMPTY;
+        int64_t LastUsed = -1;              /* Frame the page was last seen */
+        bool Pending = false;               /* Generating, not yet uploaded */
+    };
+
+    /* Page being generated into its own buffer */
+    struct Job
+    {
+        uint64_t Key;
+        int Tile;
+        std::vector<unsigned char> Texels;
+        std::atomic<bool> Done{false};
+    };
+
+    /* Feedback being read back, with the windows it was rendered with */
+    struct Readback
+    {
+        unsigned int Buffer = 0;
+        GLsync Fence = 0;
+        std::vector<int> Centers;
+    };
+
+    static const uint64_t EMPTY = ~(uint64_t)0;
+
+    Generator Generate;
+    std::vector<Tile> Tiles;
+    std::unordered_map<uint64_t, int> Resident;     /* Uploaded pages and their tiles */
+    std::vector<std::unique_ptr<Job>> Jobs;
+    std::vector<int> Centers;                       /* Page under the camera at every level */
+    std::vector<unsigned char> Table;               /* Page table, as uploaded */
+    Readback Readbacks[FEEDBACK_BUFFERS];
+    int Next = 0;                                   /* Readback the next feedback goes to */
+    int64_t Frame = 0;
+    unsigned int Framebuffer = 0;
+    unsigned int Renderbuffers[2] = {0, 0};
+    int PreviousFramebuffer = 0;
+    int PreviousViewport[4] = {0, 0, 0, 0};
+    float PreviousClear[4] = {0, 0, 0, 0};
+    ThreadPool Pool;    /* Last, so the workers stop before the jobs go */
+
+    /* Packs a page into a map key, 4 bits of level and 30 of each coordinate */
+    static uint64_t Key(const Page &page)
+    {
+        return (uint64_t)page.Level << 60 | (uint64_t)(page.X & 0x3fffffff) << 30 | (uint64_t)(page.Y & 0x3fffffff);
+    }
+
+    /* Page of the window around center that lands in the given slot */
+    int Window_Page(int slot, int center) const
+    {
+        int offset = Slot(slot - center);
+        return offset < TableSize / 2 ? center + offset : center + offset - TableSize;
+    }
+
+    /* Slot of the window a page coordinate lands in */
+    int Slot(int page) const
+    {
+        return (page % TableSize + TableSize) % TableSize;
+    }
+
+    /* Page table entry of a slot of a level */
+    unsigned char *Entry(int level, int slotX, int slotY)
+    {
+        return &Table[4 * (((size_t)level * TableSize + slotY) * TableSize + slotX)];
+    }
+
+    /* Returns the tile of the page or of its closest resident ancestor, -1 if none */
+    int Find_Tile(Page page, int *level) const
+    {
+        for (; page.Level < Levels; page.Level++)
+        {
+            std::unordered_map<uint64_t, int>::const_iterator it = Resident.find(Key(page));
+            if (it != Resident.end())
+            {
+                *level = page.Level;
+                return it->second;
+            }
+            /* Arithmetic shifts halve towards negative infinity, like the pages */
+            page.X >>= 1;
+            page.Y >>= 1;
+        }
+        return -1;
+    }
+
+    /* Adds the pages of every finished feedback readback to wanted */
+    void Read_Feedback(std::vector<Page> &wanted)
+    {
+        std::vector<bool> seen((size_t)TableSize * TableSize * Levels, false);
+        for (int i = 0; i < FEEDBACK_BUFFERS; i++)
+        {
+            Readback &readback = Readbacks[(Next + i) % FEEDBACK_BUFFERS];
+            if (!readback.Fence)
+                continue;
+            GLenum status = glClientWaitSync(readback.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(readback.Fence);
+            readback.Fence = 0;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+            const unsigned char *pixels = (const unsigned char *)glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)FeedbackWidth * FeedbackHeight * 4, GL_MAP_READ_BIT);
+            if (pixels)
+            {
+                /* Red and green hold the slot, blue the level, alpha is 0 where nothing was drawn */
+                for (int p = 0; p < FeedbackWidth * FeedbackHeight; p++)
+                {
+                    const unsigned char *pixel = pixels + 4 * p;
+                    int slotX = pixel[0], slotY = pixel[1], level = pixel[2];
+                    if (pixel[3] == 0 || slotX >= TableSize || slotY >= TableSize || level >= Levels)
+                        continue;
+                    size_t index = ((size_t)level * TableSize + slotY) * TableSize + slotX;
+                    if (seen[index])
+                        continue;
+                    seen[index] = true;
+                    wanted.push_back(Page{level, Window_Page(slotX, readback.Centers[2 * level]),
+                                          Window_Page(slotY, readback.Centers[2 * level + 1])});
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    /* Marks the wanted pages as used and starts generating the missing ones */
+    void Request(std::vector<Page> &wanted)
+    {
+        /* Coarse pages first, so every page soon has a close fallback */
+        std::sort(wanted.begin(), wanted.end(), [](const Page &a, const Page &b) { return a.Level > b.Level; });
+
+        std::vector<Page> missing;
+        for (const Page &page : wanted)
+        {
+            int level;
+            int tile = Find_Tile(page, &level);
+            if (tile >= 0)
+                Tiles[tile].LastUsed = Frame;
+            if (tile < 0 || level != page.Level)
+                missing.push_back(page);
+        }
+
+        for (const Page &page : missing)
+        {
+            if ((int)Jobs.size() >= MAX_PENDING)
+                break;
+            uint64_t key = Key(page);
+            bool pending = false;
+            for (const std::unique_ptr<Job> &job : Jobs)
+                pending |= job->Key == key;
+            if (pending)
+                continue;
+
+            int tile = Evict();
+            if (tile < 0)
+                break;
+            Tiles[tile].Key = key;
+            Tiles[tile].LastUsed = Frame;
+            Tiles[tile].Pending = true;
+
+            Jobs.emplace_back(new Job());
+            Job *job = Jobs.back().get();
+            job->Key = key;
+            job->Tile = tile;
+            job->Texels.resize((size_t)TileSize * TileSize * 3);
+
+            /* Tile texels start one border outside the page */
+            double step = (double)(1 << page.Level);
+            double x = ((double)page.X * PageSize - BORDER + 0.5) * step;
+            double y = ((double)page.Y * PageSize - BORDER + 0.5) * step;
+            int size = TileSize;
+            Generator *generate = &Generate;
+            Pool.Submit([job, generate, x, y, step, size] {
+                (*generate)(x, y, step, size, job->Texels.data());
+                job->Done = true;
+            });
+        }
+    }
+
+    /* Frees the least recently used tile not used this frame, returns -1 if there is none */
+    int Evict()
+    {
+        int best = -1;
+        for (int i = 0; i < (int)Tiles.size(); i++)
+        {
+            const Tile &tile = Tiles[i];
+            if (tile.Key == EMPTY)
+                return i;
+            if (tile.Pending || tile.LastUsed >= Frame)
+                continue;
+            if (best < 0 || tile.LastUsed < Tiles[best].LastUsed)
+                best = i;
+        }
+        if (best >= 0)
+        {
+            Resident.erase(Tiles[best].Key);
+            Tiles[best].Key = EMPTY;
+        }
+        return best;
+    }
+
+    /* Uploads finished tiles into the cache, returns whether any was */
+    bool Upload()
+    {
+        /* Borrow the active unit */
+        int previous, alignment;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, TileCache);
+
+        int uploads = 0;
+        for (size_t i = 0; i < Jobs.size() && uploads < MAX_UPLOADS;)
+        {
+            Job &job = *Jobs[i];
+            if (!job.Done)
+            {
+                i++;
+                continue;
+            }
+            int tileX = job.Tile % CacheTiles;
+            int tileY = job.Tile / CacheTiles;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, tileX * TileSize, tileY * TileSize, TileSize, TileSize,
+                            GL_BGR, GL_UNSIGNED_BYTE, job.Texels.data());
+            Tiles[job.Tile].Pending = false;
+            Resident[job.Key] = job.Tile;
+            Jobs.erase(Jobs.begin() + i);
+            uploads++;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glBindTexture(GL_TEXTURE_2D, previous);
+        return uploads > 0;
+    }
+
+    /* Points every slot of every window at its page, or the closest resident ancestor */
+    void Write_Table()
+    {
+        /* Coarsest first, so a missing page copies the entry of its parent, always inside the parent window */
+        for (int level = Levels - 1; level >= 0; level--)
+        {
+            for (int slotY = 0; slotY < TableSize; slotY++)
+            {
+                for (int slotX = 0; slotX < TableSize; slotX++)
+                {
+                    Page page{level, Window_Page(slotX, Centers[2 * level]), Window_Page(slotY, Centers[2 * level + 1])};
+                    unsigned char *entry = Entry(level, slotX, slotY);
+                    std::unordered_map<uint64_t, int>::const_iterator it = Resident.find(Key(page));
+                    if (it != Resident.end())
+                    {
+                        entry[0] = (unsigned char)(it->second % CacheTiles);
+                        entry[1] = (unsigned char)(it->second / CacheTiles);
+                        entry[2] = (unsigned char)level;
+                        entry[3] = 255;
+                    }
+                    else if (level + 1 < Levels)
+                    {
+                        /* Arithmetic shifts halve towards negative infinity, like the pages */
+                        memcpy(entry, Entry(level + 1, Slot(page.X >> 1), Slot(page.Y >> 1)), 4);
+                    }
+                    else
+                        memset(entry, 0, 4);
+                }
+            }
+        }
+
+        /* Borrow the active unit */
+        int previous, alignment;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, PageTable);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, TableSize, TableSize, Levels,
+                        GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, Table.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, previous);
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+/* Header file for tiling cellular (Worley) noise */
+
+#ifndef WORLEY_H
+#define WORLEY_H
+
+#include <cstdint>
+
+#include "basic_perlin.h"
+#include "perlin_simd.h"
+
+/*
+ * Cellular noise over a CellsX x CellsY grid of cells, one jittered feature
+ * point per cell. Coordinates are in cells and the pattern repeats every
+ * CellsX along x and CellsY along y, so textures built from it tile.
+ */
+class Worley
+{
+public:
+    int CellsX;
+    int CellsY;
+    uint64_t Seed;
+
+    /*
+     * Requires:
+     *      cellsX and cellsY are positive.
+     *
+     * Effects:
+     *      Creates cellular noise with feature points placed by seed.
+     */
+    Worley(int cellsX, int cellsY, uint64_t seed)
+        : CellsX(cellsX), CellsY(cellsY), Seed(seed)
+    {
+    }
+
+    /*
+     * Requires:
+     *      0 <= x < CellsX and 0 <= y < CellsY.
+     *
+     * Effects:
+     *      Writes the distances from (x, y) to the nearest and second nearest
+     *      feature points to f1 and f2, and a value between 0 and 1 shared by
+     *      every location nearest to the same feature point to cell.
+     */
+    void Worley_Val(double x, double y, double *f1, double *f2, double *cell) const
+    {
+        perlin_scalar::Worley(Batch_Params(), x, y, f1, f2, cell);
+    }
+
+    /*
+     * Requires:
+     *      xs, ys, f1, f2 and cell hold at least count values, every
+     *      coordinate in range as for Worley_Val.
+     *
+     * Effects:
+     *      Writes Worley_Val of every (xs[i], ys[i]) pair, several samples at
+     *      a time. Every instruction set gives bit-identical results.
+     */
+    void Worley_Batch(const double *xs, const double *ys, double *f1, double *f2, double *cell,
+                      int count) const
+    {
+        Worley_Batch_Dispatch(Batch_Params(), xs, ys, f1, f2, cell, count);
+    }
+
+private:
+    /* Fields used by the batch kernels */
+    WorleyBatchParams Batch_Params() const
+    {
+        WorleyBatchParams p;
+        p.Key = (int32_t)PerlinMixHash::Mix((uint32_t)Seed, (uint32_t)(Seed >> 32), 0, 0);
+        p.CellsX = CellsX;
+        p.CellsY = CellsY;
+        return p;
+    }
+};
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Cellular noise kernels for the Worley class.
+ *
+ * Included by perlin_simd.h after perlin_kernel.inl, once per lane type, so
+ * it shares the lane helpers, Mix_Hash and the unfused arithmetic. Every
+ * lane type gives bit-identical results.
+ */
+
+/*
+ * Effects:
+ *      Wraps cell indices between -1 and m into [0, m).
+ */
+inline VI Wrap_Cell(VI a, int m)
+{
+    return wrap_i(add_i(wrap_i(a, m), set_i(-m)), m);
+}
+
+/*
+ * Effects:
+ *      Finds the two feature points nearest to (x, y), searching the 3x3
+ *      cells around it. Writes their distances to f1 and f2 and a value
+ *      between 0 and 1 identifying the nearest cell to cell.
+ */
+inline void Worley(const WorleyBatchParams &p, VD x, VD y, VD *f1, VD *f2, VD *cell)
+{
+    VD floorX = floor_d(x), floorY = floor_d(y);
+    VI cellX = cvtt_i(floorX), cellY = cvtt_i(floorY);
+    VD offsetX = x - floorX, offsetY = y - floorY;
+
+    /* Squared distances, larger than any in the 3x3 block */
+    VD near1 = VD(16.0), near2 = VD(16.0), value = VD(0.0);
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        VI ny = Wrap_Cell(add_i(cellY, set_i(dy)), p.CellsY);
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            VI nx = Wrap_Cell(add_i(cellX, set_i(dx)), p.CellsX);
+            VI h = Mix_Hash(p.Key, nx, ny);
+
+            /* Feature point of the cell, 15 bits of jitter per axis */
+            VD px = VD((double)dx) + cvt_d(and_i(h, set_i(0x7fff))) * VD(1.0 / 32768) - offsetX;
+            VD py = VD((double)dy) + cvt_d(and_i(shr_i(h, 15), set_i(0x7fff))) * VD(1.0 / 32768) - offsetY;
+            VD d = px * px + py * py;
+
+            /* Keep the two smallest */
+            VM closest = cmp_lt(d, near1);
+            near2 = select_d(closest, near1, select_d(cmp_lt(d, near2), d, near2));
+            near1 = select_d(closest, d, near1);
+            VD id = cvt_d(and_i(xor_i(h, shr_i(h, 17)), set_i(0x3ff))) * VD(1.0 / 1024);
+            value = select_d(closest, id, value);
+        }
+    }
+
+    *f1 = sqrt_d(near1);
+    *f2 = sqrt_d(near2);
+    *cell = value;
+}
+
+/*
+ * Effects:
+ *      Evaluates Worley over whole registers and returns how many of the
+ *      count values were written.
+ */
+inline int Worley_Batch(const WorleyBatchParams &p, const double *xs, const double *ys,
+                        double *f1, double *f2, double *cell, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+    {
+        VD a, b, c;
+        Worley(p, load_d(xs + i), load_d(ys + i), &a, &b, &c);
+        store_d(f1 + i, a);
+        store_d(f2 + i, b);
+        store_d(cell + i, c);
+    }
+    return i;
+}